@@ -23,6 +23,7 @@
 #include <notifications/notificationpreviewpresenter.h>
 #include <notifications/notificationfeedbackplayer.h>
 #include <notifications/notificationlistmodel.h>
+#include <notifications/notificationgroupmodel.h>
 #include <notifications/lipsticknotification.h>
 #include <volume/volumecontrol.h>
 #include <usbmodeselector.h>
@@ -68,12 +69,15 @@ void LipstickPlugin::registerTypes(const char *uri)
     qmlRegisterType<LauncherModelType>("org.nemomobile.lipstick", 0, 1, "LauncherModel");
     qmlRegisterType<LauncherWatcherModel>("org.nemomobile.lipstick", 0, 1, "LauncherWatcherModel");
     qmlRegisterType<NotificationListModel>("org.nemomobile.lipstick", 0, 1, "NotificationListModel");
+    qmlRegisterType<NotificationGroupModel>("org.nemomobile.lipstick", 0, 1, "NotificationGroupModel");
     qmlRegisterType<LipstickNotification>("org.nemomobile.lipstick", 0, 1, "Notification");
     qmlRegisterType<LauncherItem>("org.nemomobile.lipstick", 0, 1, "LauncherItem");
     qmlRegisterType<LauncherFolderModelType>("org.nemomobile.lipstick", 0, 1, "LauncherFolderModel");
     qmlRegisterType<LauncherFolderItem>("org.nemomobile.lipstick", 0, 1, "LauncherFolderItem");
     qmlRegisterType<VolumeControl>("org.nemomobile.lipstick", 0, 1, "VolumeControl");
 
+    qmlRegisterUncreatableType<NotificationGroup>("org.nemomobile.lipstick", 0, 1, "NotificationGroup",
+                                                  "This type is created by NotificationGroupModel");
     qmlRegisterUncreatableType<NotificationPreviewPresenter>("org.nemomobile.lipstick", 0, 1,
                                                              "NotificationPreviewPresenter",
                                                              "This type is initialized by HomeApplication");
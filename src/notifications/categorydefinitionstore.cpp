@@ -16,6 +16,7 @@
 #include "categorydefinitionstore.h"
 #include <QFileInfo>
 #include <QDir>
+#include <QSettings>
 #include <QDebug>
 
 //! The file extension for the category definition files
@@ -24,6 +25,19 @@ static const char *FILE_EXTENSION = ".conf";
 //! The maximum size of the category definition file
 static const uint FILE_MAX_SIZE = 32768;
 
+namespace {
+
+QString internedString(QSet<QString> &strings, const QString &value)
+{
+    QSet<QString>::const_iterator it = strings.constFind(value);
+    if (it == strings.constEnd()) {
+        it = strings.insert(value);
+    }
+    return *it;
+}
+
+}
+
 CategoryDefinitionStore::CategoryDefinitionStore(const QString &categoryDefinitionsPath,
                                                  uint maxStoredCategoryDefinitions, QObject *parent)
     : QObject(parent),
@@ -55,26 +69,48 @@ void CategoryDefinitionStore::updateCategoryDefinitionFileList()
     if (categoryDefinitionsDir.exists()) {
         QStringList filter("*" + QString(FILE_EXTENSION));
 
-        QSet<QString> files = categoryDefinitionsDir.entryList(filter, QDir::Files).toSet();
+        QStringList fileList = categoryDefinitionsDir.entryList(filter, QDir::Files, QDir::Name);
+        QSet<QString> files = fileList.toSet();
         QSet<QString> removedFiles = m_categoryDefinitionFiles - files;
 
+        QStringList removedCategories;
         foreach(const QString &removedCategory, removedFiles) {
-            QString category = QFileInfo(removedCategory).completeBaseName();
             QString categoryDefinitionPath = m_categoryDefinitionsPath + removedCategory;
             m_categoryDefinitionPathWatcher.removePath(categoryDefinitionPath);
-            m_categoryDefinitions.remove(category);
-            emit categoryDefinitionUninstalled(category);
+            removedCategories.append(QFileInfo(removedCategory).completeBaseName());
         }
 
         m_categoryDefinitionFiles = files;
 
         // Add category definition files to watcher
+        const QStringList watchedFiles(m_categoryDefinitionPathWatcher.files());
         foreach(QString file, m_categoryDefinitionFiles){
             QString categoryDefinitionFilePath = m_categoryDefinitionsPath + file;
-            if (!m_categoryDefinitionPathWatcher.files().contains(categoryDefinitionFilePath)) {
+            if (!watchedFiles.contains(categoryDefinitionFilePath)) {
                 m_categoryDefinitionPathWatcher.addPath(categoryDefinitionFilePath);
             }
         }
+
+        // Parse all the category definitions again, dropping the strings only used by removed definitions
+        m_categoryDefinitions.clear();
+        m_strings.clear();
+        foreach (const QString &file, fileList) {
+            if (m_categoryDefinitions.count() >= (int)m_maxStoredCategoryDefinitions) {
+                qWarning() << "Too many category definitions, ignoring" << (fileList.count() - m_categoryDefinitions.count())
+                           << "definitions in" << m_categoryDefinitionsPath;
+                break;
+            }
+
+            const QString category(QFileInfo(file).completeBaseName());
+            QHash<QString, QString> parameters;
+            if (loadCategoryDefinition(category, &parameters)) {
+                m_categoryDefinitions.insert(category, parameters);
+            }
+        }
+
+        foreach (const QString &category, removedCategories) {
+            emit categoryDefinitionUninstalled(category);
+        }
     }
 }
 
@@ -83,98 +119,77 @@ void CategoryDefinitionStore::updateCategoryDefinitionFile(const QString &path)
     QFileInfo fileInfo(path);
     if (fileInfo.exists()) {
        QString category = fileInfo.completeBaseName();
-       loadSettings(category);
+
+       // Definitions skipped due to the definition limit are not loaded when they change
+       const bool loaded = m_categoryDefinitions.contains(category);
+       if (!loaded && m_categoryDefinitions.count() >= (int)m_maxStoredCategoryDefinitions) {
+           return;
+       }
+
+       QHash<QString, QString> parameters;
+       if (loadCategoryDefinition(category, &parameters)) {
+           m_categoryDefinitions.insert(category, parameters);
+       } else if (loaded) {
+           // The definition is no longer valid
+           m_categoryDefinitions.remove(category);
+       } else {
+           return;
+       }
        emit categoryDefinitionModified(category);
     }
 }
 
 bool CategoryDefinitionStore::categoryDefinitionExists(const QString &category) const
 {
-    bool categoryFound = false;
-
-    if (!m_categoryDefinitions.contains(category)) {
-        // If the category definition has not been loaded yet load it
-        loadSettings(category);
-    }
-
-    if (m_categoryDefinitions.contains(category)) {
-        categoryDefinitionAccessed(category);
-        categoryFound = true;
-    }
-
-    return categoryFound;
+    return m_categoryDefinitions.contains(category);
 }
 
 QList<QString> CategoryDefinitionStore::allKeys(const QString &category) const
 {
-    if (categoryDefinitionExists(category)) {
-        return m_categoryDefinitions.value(category)->allKeys();
-    }
-
-    return QList<QString>();
+    return m_categoryDefinitions.value(category).keys();
 }
 
 bool CategoryDefinitionStore::contains(const QString &category, const QString &key) const
 {
-    if (categoryDefinitionExists(category)) {
-        return m_categoryDefinitions.value(category)->contains(key);
-    }
-
-    return false;
+    QHash<QString, QHash<QString, QString> >::const_iterator it = m_categoryDefinitions.constFind(category);
+    return it != m_categoryDefinitions.constEnd() && it->contains(key);
 }
 
 QString CategoryDefinitionStore::value(const QString &category, const QString &key) const
 {
-    if (contains(category, key)) {
-        const QVariant &value(m_categoryDefinitions.value(category)->value(key));
-        if (value.canConvert<QStringList>()) {
-            return value.toStringList().join(QStringLiteral(","));
-        } else {
-            return value.toString();
-        }
-    }
-
-    return QString();
+    QHash<QString, QHash<QString, QString> >::const_iterator it = m_categoryDefinitions.constFind(category);
+    return it != m_categoryDefinitions.constEnd() ? it->value(key) : QString();
 }
 
 QHash<QString, QString> CategoryDefinitionStore::categoryParameters(const QString &category) const
 {
-    QHash<QString, QString> rv;
-
-    if (categoryDefinitionExists(category)) {
-        const QSettings &categoryDefinitionSettings(*(m_categoryDefinitions.value(category)));
-        foreach (const QString &key, categoryDefinitionSettings.allKeys()) {
-            const QVariant &value(categoryDefinitionSettings.value(key));
-            if (value.canConvert<QStringList>()) {
-                rv.insert(key, value.toStringList().join(QStringLiteral(",")));
-            } else {
-                rv.insert(key, value.toString());
-            }
-        }
-    }
+    return m_categoryDefinitions.value(category);
+}
 
-    return rv;
+QString CategoryDefinitionStore::categoryName(const QString &category) const
+{
+    QHash<QString, QHash<QString, QString> >::const_iterator it = m_categoryDefinitions.constFind(category);
+    return it != m_categoryDefinitions.constEnd() ? it.key() : QString();
 }
 
-void CategoryDefinitionStore::loadSettings(const QString &category) const
+bool CategoryDefinitionStore::loadCategoryDefinition(const QString &category, QHash<QString, QString> *parameters)
 {
     QFileInfo file(QString(m_categoryDefinitionsPath).append(category).append(FILE_EXTENSION));
-    if (file.exists() && file.size() != 0 && file.size() <= FILE_MAX_SIZE) {
-        QSharedPointer<QSettings> categoryDefinitionSettings(new QSettings(file.filePath(), QSettings::IniFormat));
-        if (categoryDefinitionSettings->status() == QSettings::NoError) {
-            m_categoryDefinitions.insert(category, categoryDefinitionSettings);
-        }
+    if (!file.exists() || file.size() == 0 || file.size() > FILE_MAX_SIZE) {
+        return false;
     }
-}
 
-void CategoryDefinitionStore::categoryDefinitionAccessed(const QString &category) const
-{
-    // Mark the category definition as recently used by moving it to the beginning of the usage list
-    m_categoryDefinitionUsage.removeAll(category);
-    m_categoryDefinitionUsage.insert(0, category);
+    QSettings categoryDefinitionSettings(file.filePath(), QSettings::IniFormat);
+    if (categoryDefinitionSettings.status() != QSettings::NoError) {
+        return false;
+    }
 
-    // If there are too many category definitions in memory get rid of the extra ones
-    while (m_categoryDefinitionUsage.count() > (int)m_maxStoredCategoryDefinitions) {
-        m_categoryDefinitions.remove(m_categoryDefinitionUsage.takeLast());
+    foreach (const QString &key, categoryDefinitionSettings.allKeys()) {
+        const QVariant &value(categoryDefinitionSettings.value(key));
+        const QString stringValue(value.canConvert<QStringList>() ? value.toStringList().join(QStringLiteral(","))
+                                                                  : value.toString());
+        parameters->insert(internedString(m_strings, key), internedString(m_strings, stringValue));
     }
+
+    return true;
 }
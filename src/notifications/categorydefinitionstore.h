@@ -17,10 +17,8 @@
 #define CATEGORYDEFINITIONSTORE_H_
 
 #include <QString>
-#include <QMap>
+#include <QHash>
 #include <QSet>
-#include <QSettings>
-#include <QSharedPointer>
 #include <QStringList>
 #include <QFileSystemWatcher>
 
@@ -28,6 +26,11 @@
  * A class that represents a notification category store. The category
  * store will store all the category definitions stored in the given path.
  *
+ * The category definitions are parsed when the store is created and whenever
+ * the contents of the path change. The parsed parameters are kept in a table
+ * sharing equal keys and values between the definitions, so looking up the
+ * parameters of a category does not touch the file system.
+ *
  * The category store will limit the number of configuration
  * files it will read. The rationale is to constrain memory usage and startup
  * time in case a huge number of category definitions are defined by a misbehaving
@@ -49,7 +52,6 @@ public:
 
     /*!
      * Tests if the \a category definition exists in the system.
-     * Loads the category definition if it exists.
      *
      * \param category the category to check.
      * \return \c true if the category exists, \c false otherwise.
@@ -92,15 +94,24 @@ public:
 
     /*!
      * Returns all parameters for a given category definition. If the category doesn't
-     * exist, an empty hash is returned.
+     * exist, an empty hash is returned. The returned hash shares its data with the store.
      *
      * \param category the category.
      * \sa categoryExists, allKeys, value
      */
     QHash<QString, QString> categoryParameters(const QString &category) const;
 
+    /*!
+     * Returns the name of the given \a category as stored in the store, sharing its data
+     * with the store. If the category definition doesn't exist, a null string is returned.
+     *
+     * \param category the category.
+     * \sa categoryDefinitionExists
+     */
+    QString categoryName(const QString &category) const;
+
 private slots:
-    //! Updates the list of available category definition files
+    //! Updates the list of available category definition files and parses them again
     void updateCategoryDefinitionFileList();
 
     /*!
@@ -133,17 +144,24 @@ private:
     //! The maximum number of category definitions to keep in memory
     uint m_maxStoredCategoryDefinitions;
 
-    //! Map for storing category definitions and corresponding QSettings object
-    mutable QMap<QString, QSharedPointer<QSettings> > m_categoryDefinitions;
+    //! Parsed category definition parameters keyed by category
+    QHash<QString, QHash<QString, QString> > m_categoryDefinitions;
 
-    //! List for keeping track of which category definitions have been most recently used
-    mutable QStringList m_categoryDefinitionUsage;
+    //! The parameter keys and values shared by the category definitions
+    QSet<QString> m_strings;
 
-    //! Load the data into our internal map
-    void loadSettings(const QString &category) const;
+    /*!
+     * Parses a category definition file.
+     *
+     * \param category the category
+     * \param parameters the hash to store the parameters of the category in
+     * \return \c true if the file was parsed, \c false if it is missing or not valid
+     */
+    bool loadCategoryDefinition(const QString &category, QHash<QString, QString> *parameters);
 
-    //! Marks the category to be used recently
-    void categoryDefinitionAccessed(const QString &category) const;
+#ifdef UNIT_TEST
+    friend class Ut_CategoryDefinitionStore;
+#endif
 
     //! File system watcher to notice changes in installed category definitions
     QFileSystemWatcher m_categoryDefinitionPathWatcher;
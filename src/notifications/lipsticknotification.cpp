@@ -27,6 +27,25 @@ const char *HINT_ICON = "x-nemo-icon";
 const char *HINT_PREVIEW_ICON = "x-nemo-preview-icon";
 
 const char *INTERNAL_HINT_PRIVILEGED = "privileged";
+
+quint64 timestampValue(const QVariant &value)
+{
+    switch (value.type()) {
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+        return value.toULongLong();
+    default:
+        return value.toDateTime().toMSecsSinceEpoch();
+    }
+}
+
+QString isoTimestamp(quint64 timestamp)
+{
+    // The string form keeps the second precision clients have always received
+    return QDateTime::fromMSecsSinceEpoch(timestamp, Qt::UTC).toString(Qt::ISODate);
+}
 }
 
 const char *LipstickNotification::HINT_URGENCY = "urgency";
@@ -66,24 +85,30 @@ LipstickNotification::LipstickNotification(const QString &appName, const QString
       m_explicitAppName(explicitAppName),
       m_disambiguatedAppName(disambiguatedAppName),
       m_id(id),
+      m_urgency(Normal),
       m_appIcon(appIcon),
+      m_expireTimeout(expireTimeout),
       m_summary(summary),
       m_body(body),
       m_actions(actions),
       m_hints(hints),
-      m_expireTimeout(expireTimeout),
-      m_priority(hints.value(LipstickNotification::HINT_PRIORITY).toInt()),
-      m_timestamp(hints.value(LipstickNotification::HINT_TIMESTAMP).toDateTime().toMSecsSinceEpoch()),
+      m_priority(0),
+      m_progress(0),
+      m_timestamp(0),
       m_activeProgressTimer(0)
 {
-    updateHintValues();
+    updateTimestamp();
+    updateHotHints();
+    invalidateHintValues();
 }
 
 LipstickNotification::LipstickNotification(QObject *parent)
     : QObject(parent),
       m_id(0),
+      m_urgency(Normal),
       m_expireTimeout(-1),
       m_priority(0),
+      m_progress(0),
       m_timestamp(0),
       m_activeProgressTimer(0)
 {
@@ -95,15 +120,21 @@ LipstickNotification::LipstickNotification(const LipstickNotification &notificat
       m_explicitAppName(notification.m_explicitAppName),
       m_disambiguatedAppName(notification.m_disambiguatedAppName),
       m_id(notification.m_id),
+      m_urgency(notification.m_urgency),
       m_appIcon(notification.m_appIcon),
       m_appIconOrigin(notification.m_appIconOrigin),
+      m_expireTimeout(notification.m_expireTimeout),
       m_summary(notification.m_summary),
       m_body(notification.m_body),
       m_actions(notification.m_actions),
       m_hints(notification.m_hints),
       m_hintValues(notification.m_hintValues),
-      m_expireTimeout(notification.m_expireTimeout),
       m_priority(notification.m_priority),
+      m_progress(notification.m_progress),
+      m_transient(notification.m_transient),
+      m_userRemovableByHint(notification.m_userRemovableByHint),
+      m_hasProgress(notification.m_hasProgress),
+      m_hintValuesValid(notification.m_hintValuesValid),
       m_timestamp(notification.m_timestamp),
       m_activeProgressTimer(0) // not caring for d-bus serialization
 {
@@ -223,6 +254,9 @@ QVariantHash LipstickNotification::hints() const
 
 QVariantMap LipstickNotification::hintValues() const
 {
+    if (!m_hintValuesValid) {
+        updateHintValues();
+    }
     return m_hintValues;
 }
 
@@ -243,13 +277,14 @@ void LipstickNotification::setHints(const QVariantHash &hints)
     QString oldColor = color();
 
     m_hints = hints;
-    updateHintValues();
+    updateTimestamp();
+    updateHotHints();
+    invalidateHintValues();
 
     if (oldAppIcon != appIcon()) {
         emit appIconChanged();
     }
 
-    m_timestamp = m_hints.value(LipstickNotification::HINT_TIMESTAMP).toDateTime().toMSecsSinceEpoch();
     if (oldTimestamp != m_timestamp) {
         emit timestampChanged();
     }
@@ -274,7 +309,6 @@ void LipstickNotification::setHints(const QVariantHash &hints)
         emit itemCountChanged();
     }
 
-    m_priority = m_hints.value(LipstickNotification::HINT_PRIORITY).toInt();
     if (oldPriority != m_priority) {
         emit priorityChanged();
     }
@@ -334,7 +368,7 @@ QString LipstickNotification::subText() const
 
 int LipstickNotification::urgency() const
 {
-    return m_hints.value(LipstickNotification::HINT_URGENCY, LipstickNotification::Normal).toInt();
+    return m_urgency;
 }
 
 int LipstickNotification::itemCount() const
@@ -354,7 +388,7 @@ QString LipstickNotification::category() const
 
 bool LipstickNotification::isTransient() const
 {
-    return m_hints.value(LipstickNotification::HINT_TRANSIENT).toBool();
+    return m_transient;
 }
 
 QString LipstickNotification::color() const
@@ -373,7 +407,7 @@ bool LipstickNotification::isUserRemovable() const
 
 bool LipstickNotification::isUserRemovableByHint() const
 {
-    return (m_hints.value(LipstickNotification::HINT_USER_REMOVABLE, QVariant(true)).toBool());
+    return m_userRemovableByHint;
 }
 
 QVariantList LipstickNotification::remoteActions() const
@@ -453,12 +487,12 @@ void LipstickNotification::setRestored(bool restored)
 
 qreal LipstickNotification::progress() const
 {
-    return m_hints.value(LipstickNotification::HINT_PROGRESS).toReal();
+    return m_progress;
 }
 
 bool LipstickNotification::hasProgress() const
 {
-    return m_hints.contains(LipstickNotification::HINT_PROGRESS);
+    return m_hasProgress;
 }
 
 quint64 LipstickNotification::internalTimestamp() const
@@ -508,7 +542,26 @@ bool LipstickNotification::privilegedSource() const
     return m_internalHints.value(INTERNAL_HINT_PRIVILEGED, false).toBool();
 }
 
-void LipstickNotification::updateHintValues()
+void LipstickNotification::invalidateHintValues()
+{
+    m_hintValues.clear();
+    m_hintValuesValid = false;
+
+    QVariantHash::const_iterator it = m_hints.constFind(HINT_ICON);
+    if (it != m_hints.constEnd()) {
+        qWarning() << "Notification sets deprecated hint" << HINT_ICON
+                   << "to" << it.value() << ", use app_icon parameter or"
+                   << LipstickNotification::HINT_IMAGE_PATH << "instead";
+    }
+    it = m_hints.constFind(HINT_PREVIEW_ICON);
+    if (it != m_hints.constEnd()) {
+        qWarning() << "Notification sets deprecated hint" << HINT_PREVIEW_ICON
+                   << "to" << it.value() << ", use app_icon parameter or"
+                   << LipstickNotification::HINT_IMAGE_PATH << "instead";
+    }
+}
+
+void LipstickNotification::updateHintValues() const
 {
     m_hintValues.clear();
 
@@ -517,16 +570,6 @@ void LipstickNotification::updateHintValues()
         // Filter out the hints that are represented by other properties
         const QString &hint(it.key());
 
-        if (hint == HINT_ICON) {
-            qWarning() << "Notification sets deprecated hint" << HINT_ICON
-                       << "to" << it.value() << ", use app_icon parameter or"
-                       << LipstickNotification::HINT_IMAGE_PATH << "instead";
-        } else if (hint == HINT_PREVIEW_ICON) {
-            qWarning() << "Notification sets deprecated hint" << HINT_PREVIEW_ICON
-                       << "to" << it.value() << ", use app_icon parameter or"
-                       << LipstickNotification::HINT_IMAGE_PATH << "instead";
-        }
-
         if (hint.compare(LipstickNotification::HINT_TIMESTAMP, Qt::CaseInsensitive) != 0 &&
             hint.compare(LipstickNotification::HINT_PREVIEW_SUMMARY, Qt::CaseInsensitive) != 0 &&
             hint.compare(LipstickNotification::HINT_PREVIEW_BODY, Qt::CaseInsensitive) != 0 &&
@@ -544,6 +587,40 @@ void LipstickNotification::updateHintValues()
             m_hintValues.insert(hint, it.value());
         }
     }
+
+    m_hintValuesValid = true;
+}
+
+void LipstickNotification::updateTimestamp()
+{
+    // Keep the timestamp hint in the internal representation
+    QVariantHash::iterator it = m_hints.find(LipstickNotification::HINT_TIMESTAMP);
+    if (it != m_hints.end()) {
+        m_timestamp = timestampValue(*it);
+        *it = static_cast<qint64>(m_timestamp);
+    } else {
+        m_timestamp = 0;
+    }
+}
+
+void LipstickNotification::updateHotHints()
+{
+    const QVariantHash::const_iterator end = m_hints.constEnd();
+    QVariantHash::const_iterator it = m_hints.constFind(LipstickNotification::HINT_PRIORITY);
+    m_priority = it != end ? it->toInt() : 0;
+
+    it = m_hints.constFind(LipstickNotification::HINT_URGENCY);
+    m_urgency = it != end ? it->toInt() : static_cast<int>(Normal);
+
+    it = m_hints.constFind(LipstickNotification::HINT_TRANSIENT);
+    m_transient = it != end && it->toBool();
+
+    it = m_hints.constFind(LipstickNotification::HINT_USER_REMOVABLE);
+    m_userRemovableByHint = it == end || it->toBool();
+
+    it = m_hints.constFind(LipstickNotification::HINT_PROGRESS);
+    m_hasProgress = it != end;
+    m_progress = m_hasProgress ? it->toFloat() : 0;
 }
 
 QDBusArgument &operator<<(QDBusArgument &argument, const LipstickNotification &notification)
@@ -555,7 +632,14 @@ QDBusArgument &operator<<(QDBusArgument &argument, const LipstickNotification &n
     argument << notification.m_summary;
     argument << notification.m_body;
     argument << notification.m_actions;
-    argument << notification.m_hints;
+    if (notification.m_hints.contains(LipstickNotification::HINT_TIMESTAMP)) {
+        // Timestamps are exchanged over D-Bus as ISO 8601 strings
+        QVariantHash hints(notification.m_hints);
+        hints.insert(LipstickNotification::HINT_TIMESTAMP, isoTimestamp(notification.m_timestamp));
+        argument << hints;
+    } else {
+        argument << notification.m_hints;
+    }
     argument << notification.m_expireTimeout;
     argument.endStructure();
     return argument;
@@ -574,9 +658,9 @@ const QDBusArgument &operator>>(const QDBusArgument &argument, LipstickNotificat
     argument >> notification.m_expireTimeout;
     argument.endStructure();
 
-    notification.m_priority = notification.m_hints.value(LipstickNotification::HINT_PRIORITY).toInt();
-    notification.m_timestamp = notification.m_hints.value(LipstickNotification::HINT_TIMESTAMP).toDateTime().toMSecsSinceEpoch();
-    notification.updateHintValues();
+    notification.updateTimestamp();
+    notification.updateHotHints();
+    notification.invalidateHintValues();
 
     return argument;
 }
@@ -95,7 +95,8 @@ public:
     //! Nemo hint: Priority level of the notification.
     static const char *HINT_PRIORITY;
 
-    //! Nemo hint: Timestamp of the notification.
+    //! Nemo hint: Timestamp of the notification. Carried internally as milliseconds since epoch
+    //! and exchanged over D-Bus as an ISO 8601 string.
     static const char *HINT_TIMESTAMP;
 
     //! Nemo hint: Body text of the preview of the notification.
@@ -356,19 +357,30 @@ signals:
     void colorChanged();
 
 private:
-    void updateHintValues();
+    void updateHintValues() const;
+    void invalidateHintValues();
+    void updateTimestamp();
+    void updateHotHints();
 
     //! Name of the application sending the notification
     QString m_appName;
     QString m_explicitAppName;
     QString m_disambiguatedAppName;
 
+    // The members are ordered so that the values decoded from the hints fit in what would otherwise be padding
+
     //! The ID of the notification
     uint m_id;
 
+    //! Urgency hint, decoded when the hints are set
+    int m_urgency;
+
     QString m_appIcon;
     int m_appIconOrigin = ExplicitValue;
 
+    //! Expiration timeout for the notification
+    int m_expireTimeout;
+
     //! Summary text for the notification
     QString m_summary;
 
@@ -380,16 +392,22 @@ private:
 
     //! Hints for the notification
     QVariantHash m_hints;
-    QVariantMap m_hintValues;
+    //! Hints not represented by other properties, generated when first requested
+    mutable QVariantMap m_hintValues;
     QVariantHash m_internalHints;
 
+    // Cached values for speeding up comparisons:
+    int m_priority;
+    float m_progress;
+
     bool m_restored = false;
 
-    //! Expiration timeout for the notification
-    int m_expireTimeout;
+    // Hints decoded when they are set, so that the hot paths need no lookups:
+    bool m_transient = false;
+    bool m_userRemovableByHint = true;
+    bool m_hasProgress = false;
+    mutable bool m_hintValuesValid = false;
 
-    // Cached values for speeding up comparisons:
-    int m_priority;
     quint64 m_timestamp;
     QTimer *m_activeProgressTimer;
 };
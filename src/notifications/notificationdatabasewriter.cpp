@@ -0,0 +1,196 @@
+/***************************************************************************
+**
+** Copyright (c) 2021 Jolla Ltd.
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#include <QDebug>
+#include <QHash>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+
+#include "notificationdatabasewriter.h"
+
+// Define this if you'd like to see debug messages from the notification manager
+#ifdef DEBUG_NOTIFICATIONS
+#define NOTIFICATIONS_DEBUG(things) qDebug() << Q_FUNC_INFO << things
+#else
+#define NOTIFICATIONS_DEBUG(things)
+#endif
+
+namespace {
+
+const char *WriterConnectionName = "NotificationDatabaseWriter";
+
+//! The number of prepared statements to keep around for reuse
+const int MaxPreparedStatements = 64;
+
+}
+
+NotificationDatabaseWriter::NotificationDatabaseWriter(const QString &databaseName, QObject *parent)
+    : QThread(parent),
+      m_databaseName(databaseName),
+      m_barriersQueued(0),
+      m_barriersProcessed(0),
+      m_stopping(false)
+{
+    start();
+}
+
+NotificationDatabaseWriter::~NotificationDatabaseWriter()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_commandsQueued.wakeOne();
+    }
+    wait();
+}
+
+void NotificationDatabaseWriter::execSQL(const QString &command, const QVariantList &args)
+{
+    enqueue(Command { ExecuteCommand, command, args, QByteArray() });
+}
+
+void NotificationDatabaseWriter::commit()
+{
+    enqueue(Command { CommitCommand, QString(), QVariantList(), QByteArray() });
+}
+
+void NotificationDatabaseWriter::writeFile(const QString &fileName, const QByteArray &data)
+{
+    enqueue(Command { WriteFileCommand, fileName, QVariantList(), data });
+}
+
+void NotificationDatabaseWriter::flush()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!isRunning()) {
+        return;
+    }
+
+    m_commands.append(Command { CommitCommand, QString(), QVariantList(), QByteArray() });
+    m_commands.append(Command { BarrierCommand, QString(), QVariantList(), QByteArray() });
+    const quint64 barrier = ++m_barriersQueued;
+    m_commandsQueued.wakeOne();
+
+    while (m_barriersProcessed < barrier) {
+        m_barrierReached.wait(&m_mutex);
+    }
+}
+
+void NotificationDatabaseWriter::enqueue(const Command &command)
+{
+    QMutexLocker locker(&m_mutex);
+    m_commands.append(command);
+    m_commandsQueued.wakeOne();
+}
+
+void NotificationDatabaseWriter::run()
+{
+    {
+        QSqlDatabase database = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), WriterConnectionName);
+        database.setDatabaseName(m_databaseName);
+        if (!database.open()) {
+            qWarning() << "Unable to open notification database for writing:" << database.lastError().text();
+        }
+
+        // Prepared statements keyed by the statement text
+        QHash<QString, QSqlQuery> preparedStatements;
+
+        bool inTransaction = false;
+        QMutexLocker locker(&m_mutex);
+        for (;;) {
+            while (m_commands.isEmpty() && !m_stopping) {
+                m_commandsQueued.wait(&m_mutex);
+            }
+            if (m_commands.isEmpty()) {
+                break;
+            }
+
+            QList<Command> commands;
+            commands.swap(m_commands);
+            locker.unlock();
+
+            quint64 barriers = 0;
+            foreach (const Command &command, commands) {
+                switch (command.type) {
+                case ExecuteCommand: {
+                    if (!database.isOpen()) {
+                        break;
+                    }
+                    if (!inTransaction) {
+                        inTransaction = database.transaction();
+                    }
+
+                    QHash<QString, QSqlQuery>::iterator it = preparedStatements.find(command.statement);
+                    if (it == preparedStatements.end()) {
+                        if (preparedStatements.count() >= MaxPreparedStatements) {
+                            preparedStatements.clear();
+                        }
+                        QSqlQuery query(database);
+                        if (!query.prepare(command.statement)) {
+                            NOTIFICATIONS_DEBUG(command.statement << query.lastError());
+                            break;
+                        }
+                        it = preparedStatements.insert(command.statement, query);
+                    }
+
+                    QSqlQuery &query(*it);
+                    for (int i = 0; i < command.args.count(); ++i) {
+                        query.bindValue(i, command.args.at(i));
+                    }
+                    query.exec();
+
+                    if (query.lastError().isValid()) {
+                        NOTIFICATIONS_DEBUG(command.statement << command.args << query.lastError());
+                    }
+                    query.finish();
+                    break;
+                }
+                case CommitCommand:
+                    if (inTransaction) {
+                        database.commit();
+                        inTransaction = false;
+                    }
+                    break;
+                case WriteFileCommand: {
+                    QSaveFile file(command.statement);
+                    if (!file.open(QIODevice::WriteOnly) || file.write(command.data) != command.data.size()
+                            || !file.commit()) {
+                        qWarning() << "Unable to write" << command.statement << ":" << file.errorString();
+                    }
+                    break;
+                }
+                case BarrierCommand:
+                    ++barriers;
+                    break;
+                }
+            }
+
+            locker.relock();
+            if (barriers > 0) {
+                m_barriersProcessed += barriers;
+                m_barrierReached.wakeAll();
+            }
+        }
+
+        preparedStatements.clear();
+        if (inTransaction) {
+            database.commit();
+        }
+        database.close();
+    }
+    QSqlDatabase::removeDatabase(WriterConnectionName);
+}
@@ -0,0 +1,122 @@
+/***************************************************************************
+**
+** Copyright (c) 2021 Jolla Ltd.
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#ifndef NOTIFICATIONDATABASEWRITER_H
+#define NOTIFICATIONDATABASEWRITER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QThread>
+#include <QVariantList>
+#include <QWaitCondition>
+
+/*!
+ * \class NotificationDatabaseWriter
+ *
+ * \brief Executes notification database modifications in a dedicated thread.
+ *
+ * Statements are queued by the caller and executed in order on a separate
+ * database connection owned by the writer thread, so that preparing and
+ * executing statements or committing transactions never blocks the caller.
+ * A transaction is started implicitly by the first statement following a
+ * commit. Prepared statements are cached by their text and reused when the
+ * same command is queued again. Files can be written in the same sequence,
+ * so that their content matches the committed state of the database.
+ */
+class NotificationDatabaseWriter : public QThread
+{
+public:
+    /*!
+     * Creates a database writer and starts the writer thread.
+     *
+     * \param databaseName path of the SQLite database file to write to
+     * \param parent the parent object
+     */
+    explicit NotificationDatabaseWriter(const QString &databaseName, QObject *parent = 0);
+
+    //! Commits any pending modifications and stops the writer thread.
+    virtual ~NotificationDatabaseWriter();
+
+    /*!
+     * Queues a SQL command for execution.
+     *
+     * \param command the SQL command
+     * \param args list of values to be bound to the positional placeholders ('?' -character) in the command.
+     */
+    void execSQL(const QString &command, const QVariantList &args = QVariantList());
+
+    //! Queues a commit of the current transaction, if any.
+    void commit();
+
+    /*!
+     * Queues replacing the contents of a file. The file is written atomically
+     * once all previously queued commands have been executed.
+     *
+     * \param fileName path of the file to write
+     * \param data the new contents of the file
+     */
+    void writeFile(const QString &fileName, const QByteArray &data);
+
+    /*!
+     * Commits all queued modifications and blocks until the writer thread
+     * has processed them.
+     */
+    void flush();
+
+protected:
+    void run() override;
+
+private:
+    enum CommandType {
+        ExecuteCommand,
+        CommitCommand,
+        WriteFileCommand,
+        BarrierCommand
+    };
+
+    struct Command {
+        CommandType type;
+        //! The SQL statement, or the file name for WriteFileCommand
+        QString statement;
+        QVariantList args;
+        QByteArray data;
+    };
+
+    void enqueue(const Command &command);
+
+    //! Path of the database file
+    QString m_databaseName;
+
+    //! Protects the members below
+    QMutex m_mutex;
+
+    //! Signalled when commands are queued or the thread should stop
+    QWaitCondition m_commandsQueued;
+
+    //! Signalled when barriers have been processed
+    QWaitCondition m_barrierReached;
+
+    //! Commands waiting to be executed
+    QList<Command> m_commands;
+
+    //! Number of barriers queued and processed
+    quint64 m_barriersQueued;
+    quint64 m_barriersProcessed;
+
+    //! Whether the writer thread should stop once the queue is empty
+    bool m_stopping;
+};
+
+#endif // NOTIFICATIONDATABASEWRITER_H
@@ -0,0 +1,282 @@
+/***************************************************************************
+**
+** Copyright (c) 2021 Jolla Ltd.
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#include "notificationmanager.h"
+#include "notificationgroupmodel.h"
+
+#include <QSet>
+#include <QTimer>
+#include <iterator>
+
+namespace {
+
+bool compareNotifications(const QObject *lhs, const QObject *rhs)
+{
+    return *(static_cast<const LipstickNotification *>(lhs)) < *(static_cast<const LipstickNotification *>(rhs));
+}
+
+bool compareGroups(const QObject *lhs, const QObject *rhs)
+{
+    return compareNotifications(static_cast<const NotificationGroup *>(lhs)->topNotification(),
+                                static_cast<const NotificationGroup *>(rhs)->topNotification());
+}
+
+// Moves or inserts an item to its sorted position in a model that is otherwise in order
+void placeItem(QObjectListModel *model, QObject *item, bool (*lessThan)(const QObject *, const QObject *))
+{
+    const QList<QObject *> &items(*model->getList());
+    const int currentIndex = items.indexOf(item);
+
+    // Binary search over the other items, as the item may be at a position no longer matching its contents.
+    // The item is placed after any items sorting equal to it, as in the batch updates.
+    int first = 0;
+    int count = items.count() - (currentIndex >= 0 ? 1 : 0);
+    while (count > 0) {
+        const int step = count / 2;
+        int index = first + step;
+        if (currentIndex >= 0 && index >= currentIndex) {
+            ++index;
+        }
+        if (!lessThan(item, items.at(index))) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+
+    if (currentIndex < 0) {
+        model->insertItem(first, item);
+    } else if (first == currentIndex) {
+        model->update(currentIndex);
+    } else {
+        model->move(currentIndex, first);
+    }
+}
+
+// Updates a model whose items are in order apart from the changed ones, which are placed
+// in order if they are among the items to show and removed otherwise
+void updateItems(QObjectListModel *model, const QSet<QObject *> &changed, QList<QObject *> shown,
+                 bool (*lessThan)(const QObject *, const QObject *))
+{
+    if (changed.count() == 1) {
+        if (shown.isEmpty()) {
+            model->removeItem(*changed.constBegin());
+        } else {
+            placeItem(model, shown.first(), lessThan);
+        }
+        return;
+    }
+
+    QSet<QObject *> listed;
+    QList<QObject *> unchanged;
+    foreach (QObject *item, *model->getList()) {
+        if (changed.contains(item)) {
+            listed.insert(item);
+        } else {
+            unchanged.append(item);
+        }
+    }
+
+    std::sort(shown.begin(), shown.end(), lessThan);
+    QList<QObject *> items;
+    items.reserve(unchanged.count() + shown.count());
+    std::merge(unchanged.constBegin(), unchanged.constEnd(), shown.constBegin(), shown.constEnd(),
+               std::back_inserter(items), lessThan);
+    model->synchronizeList(items);
+
+    for (int index = 0; !listed.isEmpty() && index < model->itemCount(); ++index) {
+        if (listed.remove(model->getList()->at(index))) {
+            model->update(index);
+        }
+    }
+}
+
+QString groupKey(const LipstickNotification *notification)
+{
+    const QString owner(notification->owner());
+    return owner.isEmpty() ? notification->appName() : owner;
+}
+
+}
+
+NotificationGroup::NotificationGroup(const QString &key, QObject *parent)
+    : QObject(parent)
+    , m_key(key)
+    , m_notifications(this)
+{
+}
+
+QString NotificationGroup::key() const
+{
+    return m_key;
+}
+
+QString NotificationGroup::appName() const
+{
+    LipstickNotification *notification = topNotification();
+    return notification ? notification->appName() : QString();
+}
+
+QString NotificationGroup::owner() const
+{
+    LipstickNotification *notification = topNotification();
+    return notification ? notification->owner() : QString();
+}
+
+LipstickNotification *NotificationGroup::topNotification() const
+{
+    const QList<QObject *> *notifications = const_cast<QObjectListModel &>(m_notifications).getList();
+    return notifications->isEmpty() ? 0 : static_cast<LipstickNotification *>(notifications->first());
+}
+
+QObjectListModel *NotificationGroup::notifications()
+{
+    return &m_notifications;
+}
+
+int NotificationGroup::count() const
+{
+    return m_notifications.itemCount();
+}
+
+NotificationGroupModel::NotificationGroupModel(QObject *parent)
+    : QObjectListModel(parent)
+    , m_populated(false)
+{
+    connect(NotificationManager::instance(), SIGNAL(notificationsModified(const QList<uint> &)), this, SLOT(updateNotifications(const QList<uint> &)));
+    connect(NotificationManager::instance(), SIGNAL(notificationsRemoved(const QList<uint> &)), this, SLOT(removeNotifications(const QList<uint> &)));
+
+    QTimer::singleShot(0, this, SLOT(init()));
+}
+
+NotificationGroupModel::~NotificationGroupModel()
+{
+}
+
+bool NotificationGroupModel::populated() const
+{
+    return m_populated;
+}
+
+void NotificationGroupModel::init()
+{
+    updateNotifications(NotificationManager::instance()->notificationIds());
+
+    m_populated = true;
+    emit populatedChanged(m_populated);
+}
+
+void NotificationGroupModel::updateNotifications(const QList<uint> &ids)
+{
+    QHash<NotificationGroup *, QSet<QObject *> > changedNotifications;
+    QHash<NotificationGroup *, QList<QObject *> > shownNotifications;
+    QSet<uint> handledIds;
+    foreach (uint id, ids) {
+        if (handledIds.contains(id)) {
+            continue;
+        }
+        handledIds.insert(id);
+
+        LipstickNotification *notification = NotificationManager::instance()->notification(id);
+        if (!notification) {
+            continue;
+        }
+
+        NotificationGroup *group = 0;
+        if (notificationShouldBeShown(notification)) {
+            const QString key(groupKey(notification));
+            group = m_groups.value(key);
+            if (!group) {
+                group = new NotificationGroup(key, this);
+                m_groups.insert(key, group);
+            }
+        }
+
+        if (NotificationGroup *previousGroup = m_notificationGroups.value(id)) {
+            changedNotifications[previousGroup].insert(notification);
+        }
+
+        if (group) {
+            changedNotifications[group].insert(notification);
+            shownNotifications[group].append(notification);
+            m_notificationGroups.insert(id, group);
+            m_notifications.insert(id, notification);
+        } else {
+            m_notificationGroups.remove(id);
+            m_notifications.remove(id);
+        }
+    }
+
+    QHash<NotificationGroup *, QSet<QObject *> >::const_iterator it = changedNotifications.constBegin();
+    for ( ; it != changedNotifications.constEnd(); ++it) {
+        updateItems(&it.key()->m_notifications, it.value(), shownNotifications.value(it.key()), compareNotifications);
+    }
+
+    updateGroups(changedNotifications.keys());
+}
+
+void NotificationGroupModel::removeNotifications(const QList<uint> &ids)
+{
+    QList<NotificationGroup *> changedGroups;
+    foreach (uint id, ids) {
+        NotificationGroup *group = takeNotification(id);
+        if (group && !changedGroups.contains(group)) {
+            changedGroups.append(group);
+        }
+    }
+
+    updateGroups(changedGroups);
+}
+
+bool NotificationGroupModel::notificationShouldBeShown(LipstickNotification *notification)
+{
+    return !notification->isTransient()
+        && (!notification->body().isEmpty() || !notification->summary().isEmpty());
+}
+
+NotificationGroup *NotificationGroupModel::takeNotification(uint id)
+{
+    NotificationGroup *group = m_notificationGroups.take(id);
+    LipstickNotification *notification = m_notifications.take(id);
+    if (group) {
+        group->m_notifications.removeItem(notification);
+    }
+    return group;
+}
+
+void NotificationGroupModel::updateGroups(const QList<NotificationGroup *> &groups)
+{
+    QList<QObject *> shownGroups;
+    foreach (NotificationGroup *group, groups) {
+        if (group->count() > 0) {
+            shownGroups.append(group);
+        } else {
+            removeItem(group);
+            m_groups.remove(group->key());
+            group->deleteLater();
+        }
+    }
+
+    if (!shownGroups.isEmpty()) {
+        updateItems(this, shownGroups.toSet(), shownGroups, compareGroups);
+    }
+
+    // The top notification and count of each group are reported once the groups are in place
+    foreach (QObject *item, shownGroups) {
+        NotificationGroup *group = static_cast<NotificationGroup *>(item);
+        emit group->topNotificationChanged();
+        emit group->countChanged();
+    }
+}
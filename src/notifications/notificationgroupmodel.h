@@ -0,0 +1,134 @@
+/***************************************************************************
+**
+** Copyright (c) 2021 Jolla Ltd.
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#ifndef NOTIFICATIONGROUPMODEL_H
+#define NOTIFICATIONGROUPMODEL_H
+
+#include "qobjectlistmodel.h"
+#include "lipstickglobal.h"
+
+#include <QHash>
+
+class LipstickNotification;
+
+/*!
+ * \class NotificationGroup
+ *
+ * \brief The notifications of a single application or owner.
+ *
+ * The notifications of the group are ordered like in NotificationListModel.
+ */
+class LIPSTICK_EXPORT NotificationGroup : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QString key READ key CONSTANT)
+    Q_PROPERTY(QString appName READ appName NOTIFY topNotificationChanged)
+    Q_PROPERTY(QString owner READ owner NOTIFY topNotificationChanged)
+    Q_PROPERTY(QObject *topNotification READ topNotification NOTIFY topNotificationChanged)
+    Q_PROPERTY(QObjectListModel *notifications READ notifications CONSTANT)
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+
+public:
+    explicit NotificationGroup(const QString &key, QObject *parent = 0);
+
+    //! Returns the owner or the application name the notifications of the group share
+    QString key() const;
+
+    //! Returns the application name of the top notification
+    QString appName() const;
+
+    //! Returns the owner of the top notification
+    QString owner() const;
+
+    //! Returns the notification sorting first in the group
+    LipstickNotification *topNotification() const;
+
+    //! Returns the notifications of the group
+    QObjectListModel *notifications();
+
+    //! Returns the number of notifications in the group
+    int count() const;
+
+signals:
+    void topNotificationChanged();
+    void countChanged();
+
+private:
+    QString m_key;
+    QObjectListModel m_notifications;
+
+    friend class NotificationGroupModel;
+};
+
+/*!
+ * \class NotificationGroupModel
+ *
+ * \brief A model with a row for each application or owner having notifications.
+ *
+ * Notifications with an owner hint are grouped by the owner, others by the
+ * name of the application. The groups are ordered by their top notifications.
+ * The model is updated incrementally as notifications change.
+ */
+class LIPSTICK_EXPORT NotificationGroupModel : public QObjectListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(bool populated READ populated NOTIFY populatedChanged)
+
+public:
+    explicit NotificationGroupModel(QObject *parent = 0);
+    virtual ~NotificationGroupModel();
+
+    bool populated() const;
+
+signals:
+    void populatedChanged(bool populated);
+
+private slots:
+    void init();
+    void updateNotifications(const QList<uint> &ids);
+    void removeNotifications(const QList<uint> &ids);
+
+protected:
+    /*!
+     * Checks whether the given notification should be shown. The rules
+     * match those of NotificationListModel.
+     *
+     * \param notification the notification to check
+     * \return \c true if the notification should be shown, \c false otherwise
+     */
+    virtual bool notificationShouldBeShown(LipstickNotification *notification);
+
+private:
+    Q_DISABLE_COPY(NotificationGroupModel)
+
+    NotificationGroup *takeNotification(uint id);
+    void updateGroups(const QList<NotificationGroup *> &groups);
+
+    //! Groups keyed by owner or application name
+    QHash<QString, NotificationGroup *> m_groups;
+
+    //! Groups of the listed notifications keyed by notification ID
+    QHash<uint, NotificationGroup *> m_notificationGroups;
+
+    //! The listed notifications keyed by notification ID
+    QHash<uint, LipstickNotification *> m_notifications;
+
+    bool m_populated;
+
+#ifdef UNIT_TEST
+    friend class Ut_NotificationGroupModel;
+#endif
+};
+
+#endif // NOTIFICATIONGROUPMODEL_H
@@ -0,0 +1,141 @@
+/***************************************************************************
+**
+** Copyright (c) 2021 Jolla Ltd.
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QUrl>
+
+#include "notificationimagestore.h"
+
+namespace {
+
+const QString ImageSuffix = QStringLiteral(".png");
+
+}
+
+NotificationImageStore::NotificationImageStore(const QString &path)
+    : m_path(path)
+{
+    if (!QDir::root().exists(m_path)) {
+        QDir::root().mkpath(m_path);
+    }
+}
+
+QString NotificationImageStore::imageKey(int width, int height, int stride, bool alpha, const QByteArray &data)
+{
+    QByteArray header;
+    QDataStream stream(&header, QIODevice::WriteOnly);
+    stream << qint32(width) << qint32(height) << qint32(stride) << alpha;
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(header);
+    hash.addData(data);
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+QString NotificationImageStore::fileName(const QString &key) const
+{
+    return m_path + QLatin1Char('/') + key + ImageSuffix;
+}
+
+QString NotificationImageStore::url(const QString &key) const
+{
+    return QUrl::fromLocalFile(fileName(key)).toString();
+}
+
+QString NotificationImageStore::keyForUrl(const QString &url) const
+{
+    const QString path = QUrl(url).toLocalFile();
+    if (!path.endsWith(ImageSuffix)) {
+        return QString();
+    }
+
+    const QString prefix = m_path + QLatin1Char('/');
+    if (!path.startsWith(prefix)) {
+        return QString();
+    }
+
+    const QString key = path.mid(prefix.length(), path.length() - prefix.length() - ImageSuffix.length());
+    return key.contains(QLatin1Char('/')) ? QString() : key;
+}
+
+bool NotificationImageStore::contains(const QString &key) const
+{
+    return !m_pending.contains(key) && QFile::exists(fileName(key));
+}
+
+bool NotificationImageStore::isPending(const QString &key) const
+{
+    return m_pending.contains(key);
+}
+
+void NotificationImageStore::addReference(uint id, const QString &key)
+{
+    if (m_notificationImages.value(id) == key) {
+        return;
+    }
+
+    removeReference(id);
+    m_notificationImages.insert(id, key);
+    ++m_referenceCounts[key];
+}
+
+void NotificationImageStore::removeReference(uint id)
+{
+    QHash<uint, QString>::iterator it = m_notificationImages.find(id);
+    if (it == m_notificationImages.end()) {
+        return;
+    }
+
+    const QString key = it.value();
+    m_notificationImages.erase(it);
+
+    QHash<QString, int>::iterator count = m_referenceCounts.find(key);
+    if (count != m_referenceCounts.end() && --count.value() <= 0) {
+        m_referenceCounts.erase(count);
+        if (!m_pending.contains(key)) {
+            removeFile(key);
+        }
+    }
+}
+
+void NotificationImageStore::setPending(const QString &key)
+{
+    m_pending.insert(key);
+}
+
+void NotificationImageStore::setWritten(const QString &key)
+{
+    if (m_pending.remove(key) && !m_referenceCounts.contains(key)) {
+        removeFile(key);
+    }
+}
+
+void NotificationImageStore::removeUnreferenced()
+{
+    QDir directory(m_path);
+    foreach (const QString &name, directory.entryList(QStringList() << QLatin1Char('*') + ImageSuffix, QDir::Files)) {
+        const QString key = name.left(name.length() - ImageSuffix.length());
+        if (!m_referenceCounts.contains(key) && !m_pending.contains(key)) {
+            directory.remove(name);
+        }
+    }
+}
+
+void NotificationImageStore::removeFile(const QString &key)
+{
+    QFile::remove(fileName(key));
+}
@@ -0,0 +1,144 @@
+/***************************************************************************
+**
+** Copyright (c) 2021 Jolla Ltd.
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#ifndef NOTIFICATIONIMAGESTORE_H
+#define NOTIFICATIONIMAGESTORE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QString>
+
+/*!
+ * \class NotificationImageStore
+ *
+ * \brief Keeps the images of notifications as files named after their content.
+ *
+ * Identical images used by several notifications are stored only once.
+ * Each notification references at most one image, and the file of an image
+ * is removed once no notification references it anymore. Image files are
+ * written by the caller; the store only tracks which files are still being
+ * written so that they are not removed too early.
+ */
+class NotificationImageStore
+{
+public:
+    /*!
+     * Creates an image store. The directory of the store is created if needed.
+     *
+     * \param path the path of the directory the image files are kept in
+     */
+    explicit NotificationImageStore(const QString &path);
+
+    /*!
+     * Returns the key of an image with the given properties.
+     *
+     * \param width the width of the image
+     * \param height the height of the image
+     * \param stride the number of bytes per row of the image
+     * \param alpha whether the image has an alpha channel
+     * \param data the pixel data of the image
+     * \return a key identifying the image by its contents
+     */
+    static QString imageKey(int width, int height, int stride, bool alpha, const QByteArray &data);
+
+    /*!
+     * Returns the name of the file an image is stored in.
+     *
+     * \param key the key of the image
+     * \return the absolute path of the image file
+     */
+    QString fileName(const QString &key) const;
+
+    /*!
+     * Returns the URL of the file an image is stored in.
+     *
+     * \param key the key of the image
+     * \return a file URL suitable for an image-path hint
+     */
+    QString url(const QString &key) const;
+
+    /*!
+     * Returns the key of the image a URL refers to.
+     *
+     * \param url a URL returned by url()
+     * \return the key of the image or an empty string if the URL does not refer to this store
+     */
+    QString keyForUrl(const QString &url) const;
+
+    /*!
+     * Returns whether the file of an image has been written.
+     *
+     * \param key the key of the image
+     */
+    bool contains(const QString &key) const;
+
+    /*!
+     * Returns whether the file of an image is being written.
+     *
+     * \param key the key of the image
+     */
+    bool isPending(const QString &key) const;
+
+    /*!
+     * Makes a notification reference an image, replacing any image it referenced before.
+     *
+     * \param id the ID of the notification
+     * \param key the key of the image
+     */
+    void addReference(uint id, const QString &key);
+
+    /*!
+     * Removes the image reference of a notification. The image file is removed
+     * if no other notification references it.
+     *
+     * \param id the ID of the notification
+     */
+    void removeReference(uint id);
+
+    /*!
+     * Marks the file of an image as being written.
+     *
+     * \param key the key of the image
+     */
+    void setPending(const QString &key);
+
+    /*!
+     * Marks the file of an image as written. The file is removed if no
+     * notification references the image anymore.
+     *
+     * \param key the key of the image
+     */
+    void setWritten(const QString &key);
+
+    //! Removes all image files which are neither referenced nor being written.
+    void removeUnreferenced();
+
+private:
+    void removeFile(const QString &key);
+
+    //! The directory containing the image files
+    QString m_path;
+
+    //! Image keys keyed by the IDs of the notifications referencing them
+    QHash<uint, QString> m_notificationImages;
+
+    //! Number of references to each image keyed by the image key
+    QHash<QString, int> m_referenceCounts;
+
+    //! Keys of the images whose files are being written
+    QSet<QString> m_pending;
+};
+
+#endif // NOTIFICATIONIMAGESTORE_H
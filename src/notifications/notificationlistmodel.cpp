@@ -15,6 +15,9 @@
 #include "notificationmanager.h"
 #include "notificationlistmodel.h"
 
+#include <QSet>
+#include <iterator>
+
 namespace {
 
 bool compareNotifications(const QObject *lhs, const QObject *rhs)
@@ -34,7 +37,6 @@ NotificationListModel::NotificationListModel(QObject *parent)
     , m_populated(false)
 {
     connect(NotificationManager::instance(), SIGNAL(notificationsModified(const QList<uint> &)), this, SLOT(updateNotifications(const QList<uint> &)));
-    connect(NotificationManager::instance(), SIGNAL(notificationRemoved(uint)), this, SLOT(removeNotification(uint)));
     connect(NotificationManager::instance(), SIGNAL(notificationsRemoved(const QList<uint> &)), this, SLOT(removeNotifications(const QList<uint> &)));
     connect(this, SIGNAL(clearRequested()), NotificationManager::instance(), SLOT(removeUserRemovableNotifications()));
 
@@ -103,22 +105,78 @@ void NotificationListModel::updateNotification(uint id)
 
 void NotificationListModel::updateNotifications(const QList<uint> &ids)
 {
-    foreach (uint id, ids)
-        updateNotification(id);
+    if (ids.count() == 1) {
+        updateNotification(ids.first());
+        return;
+    }
+
+    QSet<QObject *> updated;
+    QList<QObject *> shown;
+    foreach (uint id, ids) {
+        LipstickNotification *notification = NotificationManager::instance()->notification(id);
+        if (notification && !updated.contains(notification)) {
+            updated.insert(notification);
+            if (notificationShouldBeShown(notification)) {
+                shown.append(notification);
+            }
+        }
+    }
+
+    if (updated.isEmpty()) {
+        return;
+    }
+
+    // The notifications which were not updated are still in order, so merge the updated ones into them
+    const QList<QObject *> &current(*getList());
+    QSet<QObject *> listed;
+    QList<QObject *> unchanged;
+    unchanged.reserve(current.count());
+    foreach (QObject *item, current) {
+        if (updated.contains(item)) {
+            listed.insert(item);
+        } else {
+            unchanged.append(item);
+        }
+    }
+
+    sortNotifications(shown);
+    QList<QObject *> notifications;
+    notifications.reserve(unchanged.count() + shown.count());
+    std::merge(unchanged.constBegin(), unchanged.constEnd(), shown.constBegin(), shown.constEnd(),
+               std::back_inserter(notifications), compareNotifications);
+    synchronizeList(notifications);
+
+    for (int index = 0; !listed.isEmpty() && index < itemCount(); ++index) {
+        if (listed.remove(getList()->at(index))) {
+            update(index);
+        }
+    }
 }
 
 int NotificationListModel::indexFor(LipstickNotification *notification)
 {
-    for (int index = 0; index < itemCount(); index++) {
-        LipstickNotification *notificationAtIndex = static_cast<LipstickNotification *>(get(index));
-        if (notification->id() == notificationAtIndex->id()) {
-            continue;
+    // The notification may be listed already, at a position which no longer matches its contents.
+    // It is placed after any notifications sorting equal to it, as in the batch updates.
+    const QList<QObject *> &notifications(*getList());
+    const int currentIndex = notifications.indexOf(notification);
+
+    int first = 0;
+    int count = notifications.count() - (currentIndex >= 0 ? 1 : 0);
+    while (count > 0) {
+        const int step = count / 2;
+        int index = first + step;
+        if (currentIndex >= 0 && index >= currentIndex) {
+            ++index;
         }
-        if (*notification < *notificationAtIndex) {
-            return index;
+        if (!(*notification < *static_cast<LipstickNotification *>(notifications.at(index)))) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
         }
     }
-    return itemCount();
+
+    return (currentIndex >= 0 && first >= currentIndex) ? first + 1 : first;
 }
 
 void NotificationListModel::refreshModel()
@@ -131,13 +189,6 @@ void NotificationListModel::markAsDisplayed(uint id)
     NotificationManager::instance()->markNotificationDisplayed(id);
 }
 
-void NotificationListModel::removeNotification(uint id)
-{
-    if (LipstickNotification *notification = NotificationManager::instance()->notification(id)) {
-        removeItem(notification);
-    }
-}
-
 void NotificationListModel::removeNotifications(const QList<uint> &ids)
 {
     if (!ids.isEmpty()) {
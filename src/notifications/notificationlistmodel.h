@@ -38,7 +38,6 @@ signals:
 private slots:
     void init();
     void updateNotifications(const QList<uint> &ids);
-    void removeNotification(uint id);
     void removeNotifications(const QList<uint> &ids);
 
 protected:
@@ -54,7 +53,8 @@ protected:
 
     /*!
      * Checks where the notification should be placed so that the
-     * notifications in the model are ordered by timestamp.
+     * notifications in the model are ordered by timestamp. The position
+     * is found with a binary search over the other notifications.
      *
      * \param notification the notification for which to get the position
      * \return index in which the notification shoud be placed
@@ -14,11 +14,15 @@
 **
 ****************************************************************************/
 
+#include <QCache>
 #include <QCoreApplication>
 #include <QDataStream>
 #include <QDBusArgument>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QImage>
+#include <QSaveFile>
+#include <QRunnable>
 #include <QSqlDatabase>
 #include <QSqlError>
 #include <QSqlQuery>
@@ -28,15 +32,21 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QUrl>
+#include <QUuid>
 
 #include <aboutsettings.h>
 #include <mremoteaction.h>
 #include <mdesktopentry.h>
+#include <MDConfItem>
+#include <sys/stat.h>
 #include <sys/statfs.h>
+#include <grp.h>
 #include <unistd.h>
 #include <limits>
 
 #include "categorydefinitionstore.h"
+#include "notificationdatabasewriter.h"
+#include "notificationimagestore.h"
 #include "notificationmanageradaptor.h"
 #include "notificationmanager.h"
 
@@ -50,8 +60,8 @@
 //! The category definitions directory
 static const char *CATEGORY_DEFINITION_FILE_DIRECTORY = "/usr/share/lipstick/notificationcategories";
 
-//! The number configuration files to load into the event type store.
-static const uint MAX_CATEGORY_DEFINITION_FILES = 100;
+//! The number configuration files to load into the event type store. All of them are kept in memory.
+static const uint MAX_CATEGORY_DEFINITION_FILES = 500;
 
 //! Path to probe for desktop entries
 static const char *DESKTOP_ENTRY_PATH = "/usr/share/applications/";
@@ -69,6 +79,153 @@ const int DefaultNotificationPriority = 50;
 const int CommitDelay = 10 * 1000;
 const int PublicationDelay = 1000;
 
+// Progress updates are written to the database once no further update has arrived in this time
+const int ProgressSettleDelay = 2000;
+
+// Number of notifications an application can send in a burst, zero to disable rate limiting
+const char *RateLimitBurstKey = "/lipstick/notifications/rate_limit_burst";
+const int DefaultRateLimitBurst = 10;
+
+// Number of notifications per minute an application can send after using up its burst
+const char *RateLimitRateKey = "/lipstick/notifications/rate_limit_per_minute";
+const int DefaultRateLimitRate = 60;
+
+//! The number of applications whose rate of notifications is tracked before idle ones are forgotten
+const int MaxRateLimitedApplications = 128;
+
+//! The number of notification removals remembered for clients following the changes
+const int MaxRemovalHistory = 1000;
+
+// The smallest SQLITE_MAX_VARIABLE_NUMBER in use limits the values bound in a single statement
+const int MaxStatementBindValues = 999;
+
+//! The number of identified D-Bus clients to remember
+const int MaxCachedClients = 256;
+
+//! The number of processes whose details are remembered
+const int MaxCachedProcesses = 64;
+
+//! The largest width and height of notification images, matching the largest size they are displayed at
+const int MaxImageSize = 256;
+
+//! The contents of an image-data hint
+struct NotificationImageData
+{
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    bool alpha = false;
+    QByteArray data;
+};
+
+const quint32 SnapshotMagic = 0x4c4e5353; // "LNSS"
+const quint32 SnapshotVersion = 2;
+
+QVariantHash storedValues(const QVariantHash &values)
+{
+    // Mirror the conversions done when storing values to the TEXT columns of the hint tables
+    QVariantHash result;
+    QVariantHash::const_iterator it = values.constBegin(), end = values.constEnd();
+    for ( ; it != end; ++it) {
+        switch (it.value().type()) {
+        case QVariant::Bool:
+            result.insert(it.key(), QString::number(it.value().toInt()));
+            break;
+        case QVariant::ByteArray:
+            result.insert(it.key(), it.value());
+            break;
+        default:
+            result.insert(it.key(), it.value().toString());
+            break;
+        }
+    }
+    return result;
+}
+
+QStringList storedActions(const QStringList &actions)
+{
+    // Actions without an identifier or with a duplicate one are not stored
+    QStringList result;
+    QSet<QString> actionNames;
+    for (int i = 0; i + 1 < actions.count(); i += 2) {
+        const QString &action(actions.at(i));
+        if (!action.isEmpty() && !actionNames.contains(action)) {
+            actionNames.insert(action);
+            result << action << actions.at(i + 1);
+        }
+    }
+    return result;
+}
+
+QString getProcessCmdline(int pid);
+
+//! Details of a process resolved from /proc
+struct ProcessInfo
+{
+    bool isPrivileged;
+    QString processName;
+};
+
+//! Returns the start time of a process in clock ticks after boot, or 0 if not available
+quint64 getProcessStartTime(int pid)
+{
+    quint64 startTime = 0;
+    QFile file(QString::fromLatin1("/proc/%1/stat").arg(pid));
+    if (file.open(QIODevice::ReadOnly)) {
+        // The command name in the second field may contain spaces and parentheses, so
+        // count the fields from the last closing parenthesis. The start time is field 22.
+        const QByteArray data = file.readAll();
+        const QList<QByteArray> fields(data.mid(data.lastIndexOf(')') + 2).split(' '));
+        if (fields.count() > 19) {
+            startTime = fields.at(19).toULongLong();
+        }
+    }
+    return startTime;
+}
+
+gid_t privilegedGroupId()
+{
+    static const gid_t gid = []() {
+        const struct group *group = getgrnam("privileged");
+        return group ? group->gr_gid : static_cast<gid_t>(-1);
+    }();
+    return gid;
+}
+
+ProcessInfo resolveProcessInfo(int pid)
+{
+    ProcessInfo info;
+    struct stat st;
+    const QByteArray path(QByteArray("/proc/") + QByteArray::number(pid));
+    info.isPrivileged = ::stat(path.constData(), &st) == 0
+            && (st.st_uid == 0 || st.st_gid == privilegedGroupId());
+    info.processName = QFileInfo(getProcessCmdline(pid)).fileName();
+    return info;
+}
+
+ProcessInfo processInfo(int pid)
+{
+    // Pids are reused, so the processes are identified by their pid and start time
+    static QCache<QPair<int, quint64>, ProcessInfo> processes(MaxCachedProcesses);
+
+    const quint64 startTime = getProcessStartTime(pid);
+    if (startTime == 0) {
+        return resolveProcessInfo(pid);
+    }
+
+    const QPair<int, quint64> key(pid, startTime);
+    if (const ProcessInfo *info = processes.object(key)) {
+        return *info;
+    }
+
+    const ProcessInfo info(resolveProcessInfo(pid));
+    if (getProcessStartTime(pid) == startTime) {
+        // Still the same process, the details can be trusted
+        processes.insert(key, new ProcessInfo(info));
+    }
+    return info;
+}
+
 bool processIsPrivileged(int pid)
 {
     bool isPrivileged = false;
@@ -76,8 +233,7 @@ bool processIsPrivileged(int pid)
         // Internal operations are considered privileged
         isPrivileged = true;
     } else if (pid > 0) {
-        QFileInfo info(QString("/proc/%1").arg(pid));
-        isPrivileged = info.group() == QLatin1String("privileged") || info.owner() == QLatin1String("root");
+        isPrivileged = processInfo(pid).isPrivileged;
     }
     NOTIFICATIONS_DEBUG("pid" << pid << "-> isPrivileged" << isPrivileged);
     return isPrivileged;
@@ -148,7 +304,7 @@ bool processIsDBusProxy(int pid)
 
 QString getProcessName(int pid)
 {
-    QString processName = QFileInfo(getProcessCmdline(pid)).fileName();
+    const QString processName = pid > 0 ? processInfo(pid).processName : QString();
     NOTIFICATIONS_DEBUG("pid" << pid << "-> processName" << processName);
     return processName;
 }
@@ -190,6 +346,55 @@ QPair<QString, QString> processProperties(int pid)
     return rv;
 }
 
+/*!
+ * Writes the image of an image-data hint to a PNG file in the image store.
+ * The image is scaled down to the size it is displayed at, at most.
+ */
+class NotificationImageEncoder : public QRunnable
+{
+public:
+    NotificationImageEncoder(NotificationManager *manager, const QString &key, const QString &fileName,
+                             const NotificationImageData &imageData)
+        : m_manager(manager)
+        , m_key(key)
+        , m_fileName(fileName)
+        , m_imageData(imageData)
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override
+    {
+        QImage image(reinterpret_cast<const uchar *>(m_imageData.data.constData()),
+                     m_imageData.width,
+                     m_imageData.height,
+                     m_imageData.stride,
+                     m_imageData.alpha ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+        if (image.width() > MaxImageSize || image.height() > MaxImageSize) {
+            image = image.scaled(MaxImageSize, MaxImageSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        }
+
+        QSaveFile file(m_fileName);
+        if (!file.open(QIODevice::WriteOnly) || !image.save(&file, "PNG") || !file.commit()) {
+            qWarning() << "Unable to write notification image" << m_fileName << ":" << file.errorString();
+        }
+
+        QMetaObject::invokeMethod(m_manager, "imageStored", Qt::QueuedConnection, Q_ARG(QString, m_key));
+    }
+
+private:
+    NotificationManager *m_manager;
+    const QString m_key;
+    const QString m_fileName;
+    const NotificationImageData m_imageData;
+};
+
+QString notificationDataPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation)
+            + QStringLiteral("/system/privileged/Notifications");
+}
+
 bool notificationReverseOrder(const LipstickNotification *lhs, const LipstickNotification *rhs)
 {
     // Sort least significant notifications first
@@ -274,22 +479,39 @@ NotificationManager *NotificationManager::instance(bool owner)
 NotificationManager::NotificationManager(QObject *parent, bool owner)
     : QObject(parent),
       QDBusContext(),
+      m_clientPidCacheHits(0),
+      m_clientPidCacheMisses(0),
+      m_imageStore(nullptr),
       m_previousNotificationID(0),
       m_categoryDefinitionStore(new CategoryDefinitionStore(CATEGORY_DEFINITION_FILE_DIRECTORY,
                                                             MAX_CATEGORY_DEFINITION_FILES, this)),
       m_database(new QSqlDatabase),
-      m_committed(true),
-      m_nextExpirationTime(0)
+      m_databaseWriter(nullptr),
+      m_generation(-1),
+      m_snapshotOutdated(false),
+      m_rateLimitBurst(MDConfItem(RateLimitBurstKey).value(DefaultRateLimitBurst).toInt()),
+      m_rateLimitRate(MDConfItem(RateLimitRateKey).value(DefaultRateLimitRate).toInt()),
+      m_throttledNotificationCount(0),
+      m_changeEpoch(createChangeEpoch()),
+      m_changeSequence(0),
+      m_resyncSequence(0)
 {
     if (owner) {
         qDBusRegisterMetaType<QVariantHash>();
         qDBusRegisterMetaType<LipstickNotification>();
         qDBusRegisterMetaType<NotificationList>();
+        qDBusRegisterMetaType<NotificationRequest>();
+        qDBusRegisterMetaType<NotificationRequestList>();
 
         new NotificationManagerAdaptor(this);
         QDBusConnection::sessionBus().registerObject("/org/freedesktop/Notifications", this);
         QDBusConnection::sessionBus().registerService("org.freedesktop.Notifications");
 
+        // Forget identified clients once they disconnect from the bus
+        QDBusConnection::sessionBus().connect("org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus",
+                                              "NameOwnerChanged", this,
+                                              SLOT(handleNameOwnerChanged(QString, QString, QString)));
+
         connect(m_categoryDefinitionStore, SIGNAL(categoryDefinitionUninstalled(QString)),
                 this, SLOT(removeNotificationsWithCategory(QString)));
         connect(m_categoryDefinitionStore, SIGNAL(categoryDefinitionModified(QString)),
@@ -307,6 +529,10 @@ NotificationManager::NotificationManager(QObject *parent, bool owner)
         m_modificationTimer.setInterval(PublicationDelay);
         m_modificationTimer.setSingleShot(true);
         connect(&m_modificationTimer, SIGNAL(timeout()), this, SLOT(reportModifications()));
+
+        m_progressTimer.setInterval(ProgressSettleDelay);
+        m_progressTimer.setSingleShot(true);
+        connect(&m_progressTimer, SIGNAL(timeout()), this, SLOT(writeProgressUpdates()));
     }
 
     restoreNotifications(owner);
@@ -314,7 +540,15 @@ NotificationManager::NotificationManager(QObject *parent, bool owner)
 
 NotificationManager::~NotificationManager()
 {
-    m_database->commit();
+    // Converted images are posted to this object
+    m_imageEncoderPool.clear();
+    m_imageEncoderPool.waitForDone();
+
+    // Stopping the writer commits everything still queued, including the snapshot
+    commit();
+    delete m_databaseWriter;
+    delete m_imageStore;
+
     QString connectionName = m_database->connectionName();
     delete m_database;
     QSqlDatabase::removeDatabase(connectionName);
@@ -342,7 +576,11 @@ QStringList NotificationManager::GetCapabilities()
                          << LipstickNotification::HINT_PREVIEW_SUMMARY
                          << "x-nemo-remote-actions"
                          << LipstickNotification::HINT_USER_REMOVABLE
-                         << "x-nemo-get-notifications";
+                         << "x-nemo-get-notifications"
+                         << "x-nemo-notify-many"
+                         << "x-nemo-close-notifications"
+                         << "x-nemo-get-notifications-since"
+                         << "x-nemo-update-hints";
 }
 
 bool NotificationManager::isInternalOperation() const
@@ -361,22 +599,97 @@ bool NotificationManager::isInternalOperation() const
     return false;
 }
 
+bool NotificationManager::cachedClientPid(int *clientPid)
+{
+    QHash<QString, int>::const_iterator it = m_clientPids.constFind(message().service());
+    if (it == m_clientPids.constEnd()) {
+        ++m_clientPidCacheMisses;
+        NOTIFICATIONS_DEBUG("client" << message().service() << "not identified yet, misses:" << m_clientPidCacheMisses);
+        return false;
+    }
+
+    ++m_clientPidCacheHits;
+    *clientPid = it.value();
+    NOTIFICATIONS_DEBUG("client" << message().service() << "-> pid" << *clientPid << "hits:" << m_clientPidCacheHits);
+    return true;
+}
+
+ClientIdentifier *NotificationManager::identifyClient()
+{
+    ClientIdentifier *identifier = new ClientIdentifier(this, connection(), message());
+    connect(identifier, &ClientIdentifier::finished, this, [this, identifier]() {
+        if (identifier->clientPid() > 0) {
+            if (m_clientPids.count() >= MaxCachedClients) {
+                m_clientPids.clear();
+            }
+            m_clientPids.insert(identifier->clientName(), identifier->clientPid());
+        }
+    });
+    return identifier;
+}
+
+void NotificationManager::handleNameOwnerChanged(const QString &name, const QString &oldOwner,
+                                                 const QString &newOwner)
+{
+    Q_UNUSED(oldOwner)
+
+    if (newOwner.isEmpty()) {
+        m_clientPids.remove(name);
+    }
+}
+
 uint NotificationManager::Notify(const QString &appName, uint replacesId, const QString &appIcon,
                                  const QString &summary, const QString &body, const QStringList &actions,
                                  const QVariantHash &hints, int expireTimeout)
 {
     uint id = 0;
+    int clientPid = -1;
     if (isInternalOperation()) {
         id = handleNotify(getpid(), appName, replacesId, appIcon, summary, body, actions, hints, expireTimeout);
+    } else if (cachedClientPid(&clientPid)) {
+        id = handleNotify(clientPid, appName, replacesId, appIcon, summary, body, actions, hints, expireTimeout);
+        if (id == 0) {
+            sendErrorReply(QDBusError::AccessDenied, QString("PID %1 is not in privileged group").arg(clientPid));
+        }
     } else {
         setDelayedReply(true);
-        ClientIdentifier *identifier = new ClientIdentifier(this, connection(), message());
+        ClientIdentifier *identifier = identifyClient();
         connect(identifier, &ClientIdentifier::finished, this, &NotificationManager::identifiedNotify,
                 Qt::QueuedConnection);
     }
     return id;
 }
 
+QDBusArgument &operator<<(QDBusArgument &argument, const NotificationRequest &request)
+{
+    argument.beginStructure();
+    argument << request.appName;
+    argument << request.replacesId;
+    argument << request.appIcon;
+    argument << request.summary;
+    argument << request.body;
+    argument << request.actions;
+    argument << request.hints;
+    argument << request.expireTimeout;
+    argument.endStructure();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, NotificationRequest &request)
+{
+    argument.beginStructure();
+    argument >> request.appName;
+    argument >> request.replacesId;
+    argument >> request.appIcon;
+    argument >> request.summary;
+    argument >> request.body;
+    argument >> request.actions;
+    argument >> request.hints;
+    argument >> request.expireTimeout;
+    argument.endStructure();
+    return argument;
+}
+
 void NotificationManager::identifiedNotify()
 {
     ClientIdentifier *identifier = qobject_cast<ClientIdentifier *>(sender());
@@ -418,79 +731,87 @@ uint NotificationManager::handleNotify(int clientPid, const QString &appName, ui
         replacesId = 0;
     }
 
+    QPair<QString, QString> pidProperties;
+    if (clientPid > 0) {
+        // Look up the properties of the originating process
+        pidProperties = processProperties(clientPid);
+    }
+
+    // Notifications from applications exceeding their rate are collapsed into their latest notification,
+    // lipstick itself is not limited
+    const bool rateLimited = clientPid > 0 && clientPid != getpid();
+    const QString rateLimitKey(!pidProperties.first.isEmpty() ? pidProperties.first : appName);
+    // The token is only taken and the throttling only counted once the notification is published
+    const bool rateLimitApplies = replacesId == 0 && rateLimited && m_rateLimitBurst > 0;
+    const bool hasToken = rateLimitApplies && hasRateLimitToken(rateLimitKey);
+    bool throttled = false;
+    if (rateLimitApplies && !hasToken) {
+        const uint latestId = m_rateLimits.value(rateLimitKey).latestId;
+        if (m_notifications.contains(latestId)) {
+            replacesId = latestId;
+            throttled = true;
+        }
+    }
+
     uint id = replacesId != 0 ? replacesId : nextAvailableNotificationID();
 
     QVariantHash hints_(hints);
+    if (throttled) {
+        const int itemCount = m_notifications.value(replacesId)->itemCount();
+        hints_.insert(LipstickNotification::HINT_ITEM_COUNT, qMax(itemCount, 1) + 1);
+    }
 
-    // Ensure the hints contain a timestamp, and convert to UTC if required
-    QString timestamp(hints_.value(LipstickNotification::HINT_TIMESTAMP).toString());
-    if (!timestamp.isEmpty()) {
-        QDateTime tsValue(QDateTime::fromString(timestamp, Qt::ISODate));
+    // Ensure the hints contain a timestamp, carried internally as milliseconds since epoch
+    qint64 timestamp = 0;
+    const QVariant timestampHint(hints_.value(LipstickNotification::HINT_TIMESTAMP));
+    if (timestampHint.isValid()) {
+        const QDateTime tsValue(timestampHint.toDateTime());
         if (tsValue.isValid()) {
-            if (tsValue.timeSpec() != Qt::UTC) {
-                tsValue = tsValue.toUTC();
-            }
-            timestamp = tsValue.toString(Qt::ISODate);
-        } else {
-            timestamp = QString();
+            timestamp = tsValue.toMSecsSinceEpoch();
         }
     }
-    if (timestamp.isEmpty()) {
-        timestamp = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    if (timestamp == 0) {
+        timestamp = QDateTime::currentMSecsSinceEpoch();
     }
     hints_.insert(LipstickNotification::HINT_TIMESTAMP, timestamp);
 
+    // The image is written to the image store in the background and added to the notification once done
+    NotificationImageData imageData;
+    QString imageKey;
     auto it = hints_.find(LipstickNotification::HINT_IMAGE_DATA);
     if (it != hints_.end()) {
         const QDBusArgument argument = it->value<QDBusArgument>();
 
         hints_.erase(it);
 
-        int width = 0;
-        int height = 0;
-        int stride = 0;
-        bool alpha = false;
         int bitsPerSample = 0;
         int channels = 0;
-        QByteArray data;
 
         argument.beginStructure();
-        argument >> width;
-        argument >> height;
-        argument >> stride;
-        argument >> alpha;
+        argument >> imageData.width;
+        argument >> imageData.height;
+        argument >> imageData.stride;
+        argument >> imageData.alpha;
         argument >> bitsPerSample;
         argument >> channels;
-        argument >> data;
+        argument >> imageData.data;
         argument.endStructure();
 
-        if (bitsPerSample == 8 && channels == 4 && data.size() >= stride * height) {
-            const QImage image(
-                        reinterpret_cast<const uchar *>(data.constData()),
-                        width,
-                        height,
-                        stride,
-                        alpha ? QImage::Format_ARGB32 : QImage::Format_RGB32);
-
-            QBuffer buffer;
-            buffer.open(QIODevice::WriteOnly);
-            image.save(&buffer, "PNG");
-            buffer.close();
-
-            const QUrl url
-                    = QLatin1String("data:image/png;base64,")
-                    + QString::fromUtf8(buffer.data().toBase64());
-
-            hints_.insert(LipstickNotification::HINT_IMAGE_PATH, url.toString());
+        if (bitsPerSample != 8 || channels != 4 || imageData.width <= 0 || imageData.height <= 0
+                || imageData.data.size() < imageData.stride * imageData.height
+                || !m_imageStore) {
+            imageData.data.clear();
+        } else {
+            imageKey = NotificationImageStore::imageKey(imageData.width, imageData.height, imageData.stride,
+                                                        imageData.alpha, imageData.data);
+            if (m_imageStore->contains(imageKey)) {
+                // Identical image stored already for another notification
+                hints_.insert(LipstickNotification::HINT_IMAGE_PATH, m_imageStore->url(imageKey));
+                imageData.data.clear();
+            }
         }
     }
 
-    QPair<QString, QString> pidProperties;
-    if (clientPid > 0) {
-        // Look up the properties of the originating process
-        pidProperties = processProperties(clientPid);
-    }
-
     LipstickNotification notificationData(appName, appName, appName, id, appIcon,
                                           summary, body, actions, hints_, expireTimeout);
     applyCategoryDefinition(&notificationData);
@@ -509,6 +830,9 @@ uint NotificationManager::handleNotify(int clientPid, const QString &appName, ui
             ? m_notifications.value(replacesId)
             : nullptr;
 
+    // State of the replaced notification as stored in the database
+    NotificationRecord previousRecord;
+
     if (notification) {
         if (!notification->isUserRemovableByHint() && !clientIsPrivileged) {
             qWarning() << "An alteration to a persistent notification by"
@@ -517,6 +841,8 @@ uint NotificationManager::handleNotify(int clientPid, const QString &appName, ui
             return 0; // AccessDenied error reply will be sent if called from D-Bus
         }
 
+        previousRecord = notificationRecord(notification);
+
         notification->setAppName(notificationData.appName());
         notification->setExplicitAppName(notificationData.explicitAppName());
         notification->setDisambiguatedAppName(notificationData.appName());
@@ -567,29 +893,391 @@ uint NotificationManager::handleNotify(int clientPid, const QString &appName, ui
     notification->setHints(hints_);
     notification->setPrivilegedSource(clientIsPrivileged);
 
-    publish(notification, replacesId);
+    publish(notification, replacesId, replacesId != 0 ? &previousRecord : nullptr);
+
+    if (throttled) {
+        ++m_rateLimits[rateLimitKey].throttledCount;
+        ++m_throttledNotificationCount;
+        NOTIFICATIONS_DEBUG("THROTTLED:" << rateLimitKey << "->" << id);
+    } else if (rateLimitApplies) {
+        RateLimit &rateLimit(m_rateLimits[rateLimitKey]);
+        if (hasToken) {
+            rateLimit.tokens -= 1.0;
+        }
+        rateLimit.latestId = id;
+    }
+
+    // Any image still being written for the replaced notification is no longer wanted
+    m_pendingImages.remove(id);
+    if (m_imageStore) {
+        if (imageKey.isEmpty()) {
+            imageKey = m_imageStore->keyForUrl(hints_.value(LipstickNotification::HINT_IMAGE_PATH).toString());
+        }
+        if (!imageKey.isEmpty()) {
+            m_imageStore->addReference(id, imageKey);
+        } else {
+            m_imageStore->removeReference(id);
+        }
+
+        if (!imageData.data.isEmpty()) {
+            m_pendingImages.insert(id, imageKey);
+            if (!m_imageStore->isPending(imageKey)) {
+                m_imageStore->setPending(imageKey);
+                m_imageEncoderPool.start(new NotificationImageEncoder(this, imageKey, m_imageStore->fileName(imageKey),
+                                                                      imageData));
+            }
+        }
+    }
 
     return id;
 }
 
+bool NotificationManager::hasRateLimitToken(const QString &application)
+{
+    if (m_rateLimitBurst <= 0) {
+        return true;
+    }
+
+    const qint64 currentTime(QDateTime::currentMSecsSinceEpoch());
+    QHash<QString, RateLimit>::iterator it = m_rateLimits.find(application);
+    if (it == m_rateLimits.end()) {
+        if (m_rateLimits.count() >= MaxRateLimitedApplications) {
+            // Forget the applications that have not sent anything for long enough to have a full bucket
+            const qint64 refillTime(m_rateLimitRate > 0 ? m_rateLimitBurst * 60000 / m_rateLimitRate : 0);
+            for (QHash<QString, RateLimit>::iterator rl = m_rateLimits.begin(); rl != m_rateLimits.end(); ) {
+                if (currentTime - rl->updated >= refillTime) {
+                    rl = m_rateLimits.erase(rl);
+                } else {
+                    ++rl;
+                }
+            }
+        }
+        it = m_rateLimits.insert(application, RateLimit());
+        it->tokens = m_rateLimitBurst;
+        it->updated = currentTime;
+    } else if (currentTime > it->updated) {
+        // Refill the bucket for the time passed since the previous notification
+        it->tokens = qMin<qreal>(m_rateLimitBurst,
+                                 it->tokens + (currentTime - it->updated) * m_rateLimitRate / 60000.0);
+        it->updated = currentTime;
+    }
+
+    return it->tokens >= 1.0;
+}
+
+QVariantMap NotificationManager::GetStatistics()
+{
+    QVariantMap throttledApplications;
+    QHash<QString, RateLimit>::const_iterator it = m_rateLimits.constBegin();
+    for ( ; it != m_rateLimits.constEnd(); ++it) {
+        if (it->throttledCount > 0) {
+            throttledApplications.insert(it.key(), it->throttledCount);
+        }
+    }
+
+    QVariantMap statistics;
+    statistics.insert(QStringLiteral("notifications"), m_notifications.count());
+    statistics.insert(QStringLiteral("throttledNotifications"), m_throttledNotificationCount);
+    statistics.insert(QStringLiteral("throttledApplications"), throttledApplications);
+    statistics.insert(QStringLiteral("clientPidCacheHits"), m_clientPidCacheHits);
+    statistics.insert(QStringLiteral("clientPidCacheMisses"), m_clientPidCacheMisses);
+    return statistics;
+}
+
+void NotificationManager::imageStored(const QString &key)
+{
+    if (!m_imageStore) {
+        return;
+    }
+
+    m_imageStore->setWritten(key);
+    const bool written = m_imageStore->contains(key);
+    const QString url = m_imageStore->url(key);
+
+    QHash<uint, QString>::iterator it = m_pendingImages.begin();
+    while (it != m_pendingImages.end()) {
+        if (it.value() != key) {
+            ++it;
+            continue;
+        }
+
+        const uint id = it.key();
+        it = m_pendingImages.erase(it);
+
+        LipstickNotification *notification = m_notifications.value(id);
+        if (!notification || !written) {
+            continue;
+        }
+
+        // Attaching the image is not a replacement by the client: the expiration is kept and the
+        // change is only reported in the batched modifications, so the preview is not shown again
+        const NotificationRecord previousRecord(notificationRecord(notification));
+        QVariantHash hints(notification->hints());
+        hints.insert(LipstickNotification::HINT_IMAGE_PATH, url);
+        notification->setHints(hints);
+        recordChange(id);
+        storeUpdate(notification, previousRecord);
+        addModification(id);
+    }
+}
+
 void NotificationManager::deleteNotification(uint id)
 {
-    // Remove the notification, its actions and its hints from database
-    const QVariantList params(QVariantList() << id);
-    execSQL(QString("DELETE FROM notifications WHERE id=?"), params);
-    execSQL(QString("DELETE FROM actions WHERE id=?"), params);
-    execSQL(QString("DELETE FROM hints WHERE id=?"), params);
-    execSQL(QString("DELETE FROM internal_hints WHERE id=?"), params);
-    execSQL(QString("DELETE FROM expiration WHERE id=?"), params);
+    deleteNotifications(QList<uint>() << id);
+}
+
+void NotificationManager::deleteNotifications(const QList<uint> &ids)
+{
+    // Remove the notifications, their actions and their hints from database
+    static const QStringList tableNames(QStringList() << QStringLiteral("notifications") << QStringLiteral("actions")
+                                       << QStringLiteral("hints") << QStringLiteral("internal_hints")
+                                       << QStringLiteral("expiration"));
+
+    for (int first = 0; first < ids.count(); first += MaxStatementBindValues) {
+        const int count = qMin(ids.count() - first, MaxStatementBindValues);
+        QVariantList params;
+        params.reserve(count);
+        QString placeholders(QStringLiteral("?"));
+        for (int i = 0; i < count; ++i) {
+            params.append(ids.at(first + i));
+            if (i > 0) {
+                placeholders.append(QStringLiteral(", ?"));
+            }
+        }
+
+        foreach (const QString &tableName, tableNames) {
+            execSQL(QStringLiteral("DELETE FROM ") + tableName + QStringLiteral(" WHERE id IN (") + placeholders
+                    + QLatin1Char(')'), params);
+        }
+    }
+
+    foreach (uint id, ids) {
+        removeExpiration(id);
+        m_progressRecords.remove(id);
+
+        m_pendingImages.remove(id);
+        if (m_imageStore) {
+            m_imageStore->removeReference(id);
+        }
+    }
+}
+
+void NotificationManager::UpdateHints(uint id, const QVariantHash &changed, const QStringList &removed)
+{
+    int clientPid = -1;
+    if (isInternalOperation()) {
+        handleUpdateHints(getpid(), id, changed, removed);
+    } else if (cachedClientPid(&clientPid)) {
+        const QDBusError::ErrorType error = handleUpdateHints(clientPid, id, changed, removed);
+        if (error == QDBusError::InvalidArgs) {
+            sendErrorReply(error, QString("Notification %1 does not exist").arg(id));
+        } else if (error != QDBusError::NoError) {
+            sendErrorReply(error, QString("PID %1 is not in privileged group").arg(clientPid));
+        }
+    } else {
+        setDelayedReply(true);
+        ClientIdentifier *identifier = identifyClient();
+        connect(identifier, &ClientIdentifier::finished, this, &NotificationManager::identifiedUpdateHints,
+                Qt::QueuedConnection);
+    }
+}
+
+void NotificationManager::identifiedUpdateHints()
+{
+    ClientIdentifier *identifier = qobject_cast<ClientIdentifier *>(sender());
+    QVariantList arguments(identifier->message().arguments());
+    uint id = arguments.at(0).toUInt();
+    const QDBusArgument changedArg(arguments.at(1).value<QDBusArgument>());
+    QVariantHash changed;
+    changedArg >> changed;
+    QStringList removed = arguments.at(2).toStringList();
+    const QDBusError::ErrorType error = handleUpdateHints(identifier->clientPid(), id, changed, removed);
+    if (identifier->message().isReplyRequired()) {
+        QDBusMessage reply;
+        if (error == QDBusError::InvalidArgs) {
+            QString errorString = QString("Notification %1 does not exist").arg(id);
+            reply = identifier->message().createErrorReply(error, errorString);
+        } else if (error != QDBusError::NoError) {
+            QString errorString = QString("PID %1 is not in privileged group").arg(identifier->clientPid());
+            reply = identifier->message().createErrorReply(error, errorString);
+        } else {
+            reply = identifier->message().createReply();
+        }
+        identifier->connection().send(reply);
+    }
+    identifier->deleteLater();
+}
+
+QDBusError::ErrorType NotificationManager::handleUpdateHints(int clientPid, uint id, const QVariantHash &changed,
+                                                             const QStringList &removed)
+{
+    NOTIFICATIONS_DEBUG("clientPid:" << clientPid << "id:" << id << "changed:" << changed << "removed:" << removed);
+    LipstickNotification *notification = m_notifications.value(id);
+    if (!notification) {
+        return QDBusError::InvalidArgs;
+    }
+
+    const bool clientIsPrivileged = processIsPrivileged(clientPid);
+    if (!notification->isUserRemovableByHint() && !clientIsPrivileged) {
+        qWarning() << "An alteration to a persistent notification was ignored because of insufficent permissions";
+        return QDBusError::AccessDenied;
+    }
+
+    QVariantHash hints(notification->hints());
+    foreach (const QString &hint, removed) {
+        // Notifications always carry a timestamp
+        if (hint != LipstickNotification::HINT_TIMESTAMP) {
+            hints.remove(hint);
+        }
+    }
+    for (QVariantHash::const_iterator it = changed.constBegin(); it != changed.constEnd(); ++it) {
+        if (it.key() == LipstickNotification::HINT_IMAGE_DATA) {
+            // Images are only converted for complete notifications
+            continue;
+        } else if (it.key() == LipstickNotification::HINT_TIMESTAMP) {
+            const QDateTime timestamp(it.value().toDateTime());
+            if (timestamp.isValid()) {
+                hints.insert(it.key(), timestamp.toMSecsSinceEpoch());
+            }
+        } else {
+            hints.insert(it.key(), it.value());
+        }
+    }
+
+    const QVariant userRemovable(hints.value(LipstickNotification::HINT_USER_REMOVABLE));
+    if (userRemovable.isValid() && !userRemovable.toBool() && !clientIsPrivileged) {
+        qWarning() << "Making a notification persistent was ignored because of insufficent permissions";
+        return QDBusError::AccessDenied;
+    }
+
+    if (hints == notification->hints()) {
+        return QDBusError::NoError;
+    }
+
+    const NotificationRecord previousRecord(notificationRecord(notification));
+    const bool progressChanged = hints.value(LipstickNotification::HINT_PROGRESS)
+            != notification->hints().value(LipstickNotification::HINT_PROGRESS);
+    notification->setHints(hints);
+    if (progressChanged) {
+        notification->restartProgressTimer();
+    }
+    publish(notification, id, &previousRecord);
+
+    if (m_imageStore) {
+        const QString imageKey(m_imageStore->keyForUrl(hints.value(LipstickNotification::HINT_IMAGE_PATH).toString()));
+        if (!imageKey.isEmpty()) {
+            m_imageStore->addReference(id, imageKey);
+        } else if (!m_pendingImages.contains(id)) {
+            m_imageStore->removeReference(id);
+        }
+    }
+
+    return QDBusError::NoError;
+}
+
+QList<uint> NotificationManager::NotifyMany(const NotificationRequestList &requests)
+{
+    QList<uint> ids;
+    int clientPid = -1;
+    if (isInternalOperation()) {
+        ids = handleNotifyMany(getpid(), requests);
+    } else if (cachedClientPid(&clientPid)) {
+        ids = handleNotifyMany(clientPid, requests);
+    } else {
+        setDelayedReply(true);
+        ClientIdentifier *identifier = identifyClient();
+        connect(identifier, &ClientIdentifier::finished, this, &NotificationManager::identifiedNotifyMany,
+                Qt::QueuedConnection);
+    }
+    return ids;
+}
+
+void NotificationManager::identifiedNotifyMany()
+{
+    ClientIdentifier *identifier = qobject_cast<ClientIdentifier *>(sender());
+    QVariantList arguments(identifier->message().arguments());
+    const NotificationRequestList requests(qdbus_cast<NotificationRequestList>(arguments.at(0)));
+    const QList<uint> ids(handleNotifyMany(identifier->clientPid(), requests));
+    if (identifier->message().isReplyRequired()) {
+        QDBusMessage reply = identifier->message().createReply(QVariant::fromValue(ids));
+        identifier->connection().send(reply);
+    }
+    identifier->deleteLater();
+}
+
+QList<uint> NotificationManager::handleNotifyMany(int clientPid, const NotificationRequestList &requests)
+{
+    NOTIFICATIONS_DEBUG("clientPid:" << clientPid << "requests:" << requests.count());
+
+    // The writes are queued into the same transaction and the modifications reported together
+    QList<uint> ids;
+    ids.reserve(requests.count());
+    foreach (const NotificationRequest &request, requests) {
+        ids.append(handleNotify(clientPid, request.appName, request.replacesId, request.appIcon, request.summary,
+                                request.body, request.actions, request.hints, request.expireTimeout));
+    }
+    return ids;
+}
+
+void NotificationManager::CloseNotifications(const QList<uint> &ids)
+{
+    int clientPid = -1;
+    if (isInternalOperation()) {
+        handleCloseNotifications(getpid(), ids);
+    } else if (cachedClientPid(&clientPid)) {
+        handleCloseNotifications(clientPid, ids);
+    } else {
+        setDelayedReply(true);
+        ClientIdentifier *identifier = identifyClient();
+        connect(identifier, &ClientIdentifier::finished,
+                this, &NotificationManager::identifiedCloseNotifications, Qt::QueuedConnection);
+    }
+}
+
+void NotificationManager::identifiedCloseNotifications()
+{
+    ClientIdentifier *identifier = qobject_cast<ClientIdentifier *>(sender());
+    QVariantList arguments(identifier->message().arguments());
+    handleCloseNotifications(identifier->clientPid(), qdbus_cast<QList<uint> >(arguments.at(0)));
+    if (identifier->message().isReplyRequired()) {
+        QDBusMessage reply = identifier->message().createReply();
+        identifier->connection().send(reply);
+    }
+    identifier->deleteLater();
+}
+
+void NotificationManager::handleCloseNotifications(int clientPid, const QList<uint> &ids)
+{
+    NOTIFICATIONS_DEBUG("clientPid:" << clientPid << "ids:" << ids);
+    const bool clientIsPrivileged = processIsPrivileged(clientPid);
+    QList<uint> closableIds;
+    bool denied = false;
+    foreach (uint id, ids) {
+        if (const LipstickNotification *notification = m_notifications.value(id)) {
+            if (notification->isUserRemovableByHint() || clientIsPrivileged) {
+                closableIds.append(id);
+            } else {
+                denied = true;
+            }
+        }
+    }
+
+    if (denied) {
+        qWarning() << "An application was not allowed to close notifications due to insufficient permissions";
+    }
+    closeNotifications(closableIds, CloseNotificationCalled);
 }
 
 void NotificationManager::CloseNotification(uint id, NotificationClosedReason closeReason)
 {
+    int clientPid = -1;
     if (isInternalOperation()) {
         handleCloseNotification(getpid(), id, closeReason);
+    } else if (cachedClientPid(&clientPid)) {
+        handleCloseNotification(clientPid, id, closeReason);
     } else {
         setDelayedReply(true);
-        ClientIdentifier *identifier = new ClientIdentifier(this, connection(), message());
+        ClientIdentifier *identifier = identifyClient();
         connect(identifier, &ClientIdentifier::finished,
                 this, &NotificationManager::identifiedCloseNotification, Qt::QueuedConnection);
     }
@@ -625,9 +1313,12 @@ void NotificationManager::handleCloseNotification(int clientPid, uint id, Notifi
         deleteNotification(id);
 
         NOTIFICATIONS_DEBUG("REMOVE:" << id);
+        emit notificationsRemoved(QList<uint>() << id);
         emit notificationRemoved(id);
 
         // Mark the notification to be destroyed
+        unindexNotification(id);
+        recordRemoval(id);
         m_removedNotifications.insert(m_notifications.take(id));
     }
 }
@@ -640,22 +1331,31 @@ void NotificationManager::closeNotifications(const QList<uint> &ids, Notificatio
     foreach (uint id, uniqueIds) {
         if (m_notifications.contains(id)) {
             removedIds.append(id);
-            emit NotificationClosed(id, closeReason);
-
-            deleteNotification(id);
         }
     }
 
-    if (!removedIds.isEmpty()) {
-        NOTIFICATIONS_DEBUG("REMOVE:" << removedIds);
-        emit notificationsRemoved(removedIds);
+    if (removedIds.isEmpty()) {
+        return;
+    }
 
-        foreach (uint id, removedIds) {
-            emit notificationRemoved(id);
+    deleteNotifications(removedIds);
 
-            // Mark the notification to be destroyed
-            m_removedNotifications.insert(m_notifications.take(id));
-        }
+    // NotificationClosed is still emitted per notification for clients following the specification
+    foreach (uint id, removedIds) {
+        emit NotificationClosed(id, closeReason);
+    }
+    emit NotificationsClosed(removedIds, closeReason);
+
+    NOTIFICATIONS_DEBUG("REMOVE:" << removedIds);
+    emit notificationsRemoved(removedIds);
+
+    foreach (uint id, removedIds) {
+        emit notificationRemoved(id);
+
+        // Mark the notification to be destroyed
+        unindexNotification(id);
+        recordRemoval(id);
+        m_removedNotifications.insert(m_notifications.take(id));
     }
 }
 
@@ -663,7 +1363,7 @@ void NotificationManager::markNotificationDisplayed(uint id)
 {
     if (m_notifications.contains(id)) {
         const LipstickNotification *notification = m_notifications.value(id);
-        if (notification->hints().value(LipstickNotification::HINT_TRANSIENT).toBool()) {
+        if (notification->isTransient()) {
             // Remove this notification immediately
             CloseNotification(id, NotificationExpired);
             NOTIFICATIONS_DEBUG("REMOVED transient:" << id);
@@ -673,13 +1373,10 @@ void NotificationManager::markNotificationDisplayed(uint id)
                 // Insert the timeout into the expiration table, or leave the existing value if already present
                 const qint64 currentTime(QDateTime::currentDateTimeUtc().toMSecsSinceEpoch());
                 const qint64 expireAt(currentTime + timeout);
-                execSQL(QString("INSERT OR IGNORE INTO expiration(id, expire_at) VALUES(?, ?)"),
-                        QVariantList() << id << expireAt);
-
-                if (m_nextExpirationTime == 0 || (expireAt < m_nextExpirationTime)) {
-                    // This will be the next notification to expire - update the timer
-                    m_nextExpirationTime = expireAt;
-                    m_expirationTimer.start(timeout);
+                if (addExpiration(id, expireAt)) {
+                    execSQL(QString("INSERT OR IGNORE INTO expiration(id, expire_at) VALUES(?, ?)"),
+                            QVariantList() << id << expireAt);
+                    scheduleExpiration(currentTime);
                 }
 
                 NOTIFICATIONS_DEBUG("DISPLAYED:" << id << "expiring in:" << timeout);
@@ -701,11 +1398,14 @@ QString NotificationManager::GetServerInformation(QString &vendor, QString &vers
 NotificationList NotificationManager::GetNotifications(const QString &owner)
 {
     NotificationList notificationList;
+    int clientPid = -1;
     if (isInternalOperation()) {
         notificationList = handleGetNotifications(getpid(), owner);
+    } else if (cachedClientPid(&clientPid)) {
+        notificationList = handleGetNotifications(clientPid, owner);
     } else {
         setDelayedReply(true);
-        ClientIdentifier *identifier = new ClientIdentifier(this, connection(), message());
+        ClientIdentifier *identifier = identifyClient();
         connect(identifier, &ClientIdentifier::finished,
                 this, &NotificationManager::identifiedGetNotifications, Qt::QueuedConnection);
     }
@@ -723,69 +1423,188 @@ void NotificationManager::identifiedGetNotifications()
         reply << QVariant::fromValue(notificationList);
         identifier->connection().send(reply);
     }
-    identifier->deleteLater();
+    identifier->deleteLater();
+}
+
+NotificationList NotificationManager::handleGetNotifications(int clientPid, const QString &owner)
+{
+    NOTIFICATIONS_DEBUG("clientPid:" << clientPid << "owner:" << owner);
+    QString callerProcessName = getProcessName(clientPid);
+    QList<LipstickNotification *> notificationList;
+    foreach (uint id, m_ownerIndex.values(owner)) {
+        notificationList.append(m_notifications.value(id));
+    }
+    if (!callerProcessName.isEmpty() && callerProcessName != owner) {
+        foreach (uint id, m_ownerIndex.values(callerProcessName)) {
+            notificationList.append(m_notifications.value(id));
+        }
+    }
+
+    return NotificationList(notificationList);
+}
+
+NotificationList NotificationManager::GetNotificationsByCategory(const QString &category)
+{
+    NotificationList notificationList;
+    int clientPid = -1;
+    if (isInternalOperation()) {
+        notificationList = handleGetNotificationsByCategory(getpid(), category);
+    } else if (cachedClientPid(&clientPid)) {
+        notificationList = handleGetNotificationsByCategory(clientPid, category);
+    } else {
+        setDelayedReply(true);
+        ClientIdentifier *identifier = identifyClient();
+        connect(identifier, &ClientIdentifier::finished,
+                this, &NotificationManager::identifiedGetNotificationsByCategory, Qt::QueuedConnection);
+    }
+    return notificationList;
+}
+
+void NotificationManager::identifiedGetNotificationsByCategory()
+{
+    ClientIdentifier *identifier = qobject_cast<ClientIdentifier *>(sender());
+    QVariantList arguments(identifier->message().arguments());
+    const QString category = arguments.at(0).toString();
+    NotificationList notificationList = handleGetNotificationsByCategory(identifier->clientPid(), category);
+    if (identifier->message().isReplyRequired()) {
+        QDBusMessage reply = identifier->message().createReply();
+        reply << QVariant::fromValue(notificationList);
+        identifier->connection().send(reply);
+    }
+    identifier->deleteLater();
+}
+
+NotificationList NotificationManager::handleGetNotificationsByCategory(int clientPid, const QString &category)
+{
+    NOTIFICATIONS_DEBUG("clientPid:" << clientPid << "category:" << category);
+    QList<LipstickNotification *> notificationList;
+    if (processIsPrivileged(clientPid)) {
+        foreach (uint id, m_categoryIndex.values(category)) {
+            notificationList.append(m_notifications.value(id));
+        }
+    }
+    return NotificationList(notificationList);
+}
+
+NotificationList NotificationManager::GetNotificationsSince(quint64 token, QList<uint> &removedIds,
+                                                            quint64 &currentToken, bool &resyncRequired)
+{
+    NotificationList notificationList;
+    int clientPid = -1;
+    if (isInternalOperation()) {
+        handleGetNotificationsSince(getpid(), token, &notificationList, &removedIds, &currentToken, &resyncRequired);
+    } else if (cachedClientPid(&clientPid)) {
+        if (!handleGetNotificationsSince(clientPid, token, &notificationList, &removedIds, &currentToken,
+                                         &resyncRequired)) {
+            sendErrorReply(QDBusError::AccessDenied, QString("PID %1 is not in privileged group").arg(clientPid));
+        }
+    } else {
+        setDelayedReply(true);
+        ClientIdentifier *identifier = identifyClient();
+        connect(identifier, &ClientIdentifier::finished,
+                this, &NotificationManager::identifiedGetNotificationsSince, Qt::QueuedConnection);
+    }
+    return notificationList;
+}
+
+void NotificationManager::identifiedGetNotificationsSince()
+{
+    ClientIdentifier *identifier = qobject_cast<ClientIdentifier *>(sender());
+    QVariantList arguments(identifier->message().arguments());
+    const quint64 token = arguments.at(0).toULongLong();
+    NotificationList notificationList;
+    QList<uint> removedIds;
+    quint64 currentToken = 0;
+    bool resyncRequired = false;
+    bool allowed = handleGetNotificationsSince(identifier->clientPid(), token, &notificationList, &removedIds,
+                                               &currentToken, &resyncRequired);
+    if (identifier->message().isReplyRequired()) {
+        QDBusMessage reply;
+        if (!allowed) {
+            QString errorString = QString("PID %1 is not in privileged group").arg(identifier->clientPid());
+            reply = identifier->message().createErrorReply(QDBusError::AccessDenied, errorString);
+        } else {
+            reply = identifier->message().createReply();
+            reply << QVariant::fromValue(notificationList) << QVariant::fromValue(removedIds) << currentToken
+                  << resyncRequired;
+        }
+        identifier->connection().send(reply);
+    }
+    identifier->deleteLater();
+}
+
+bool NotificationManager::handleGetNotificationsSince(int clientPid, quint64 token, NotificationList *notifications,
+                                                      QList<uint> *removedIds, quint64 *currentToken,
+                                                      bool *resyncRequired)
+{
+    NOTIFICATIONS_DEBUG("clientPid:" << clientPid << "token:" << token);
+    removedIds->clear();
+    *currentToken = (static_cast<quint64>(m_changeEpoch) << 32) | m_changeSequence;
+    *resyncRequired = false;
+
+    if (!processIsPrivileged(clientPid)) {
+        *notifications = NotificationList();
+        return false;
+    }
+
+    const quint32 epoch = static_cast<quint32>(token >> 32);
+    const quint32 sequence = static_cast<quint32>(token);
+    QList<LipstickNotification *> notificationList;
+    if (epoch != m_changeEpoch || sequence < m_resyncSequence || sequence > m_changeSequence) {
+        // The token is from another lipstick instance, or the changes since it have been forgotten
+        *resyncRequired = true;
+        notificationList = m_notifications.values();
+    } else {
+        QMap<quint32, uint>::const_iterator it = m_changedNotifications.upperBound(sequence);
+        for ( ; it != m_changedNotifications.constEnd(); ++it) {
+            notificationList.append(m_notifications.value(it.value()));
+        }
+        for (it = m_removalHistory.upperBound(sequence); it != m_removalHistory.constEnd(); ++it) {
+            removedIds->append(it.value());
+        }
+    }
+    *notifications = NotificationList(notificationList);
+    return true;
 }
 
-NotificationList NotificationManager::handleGetNotifications(int clientPid, const QString &owner)
+quint32 NotificationManager::createChangeEpoch()
 {
-    NOTIFICATIONS_DEBUG("clientPid:" << clientPid << "owner:" << owner);
-    QString callerProcessName = getProcessName(clientPid);
-    QList<LipstickNotification *> notificationList;
-    QHash<uint, LipstickNotification *>::const_iterator it = m_notifications.constBegin(), end = m_notifications.constEnd();
-    for ( ; it != end; ++it) {
-        LipstickNotification *notification = it.value();
-        if (notification->owner() == owner
-                || (!callerProcessName.isEmpty() && (notification->owner() == callerProcessName))) {
-            notificationList.append(notification);
-        }
+    // Random, so that tokens of an earlier instance are not mistaken for ours regardless of the clock.
+    // Zero is never used, so that a zero token always requires a resync.
+    quint32 epoch = 0;
+    while (epoch == 0) {
+        epoch = QUuid::createUuid().data1;
     }
-
-    return NotificationList(notificationList);
+    return epoch;
 }
 
-NotificationList NotificationManager::GetNotificationsByCategory(const QString &category)
+void NotificationManager::recordChange(uint id)
 {
-    NotificationList notificationList;
-    if (isInternalOperation()) {
-        notificationList = handleGetNotificationsByCategory(getpid(), category);
+    QHash<uint, quint32>::iterator it = m_changeSequences.find(id);
+    if (it != m_changeSequences.end()) {
+        m_changedNotifications.remove(it.value());
+        it.value() = ++m_changeSequence;
     } else {
-        setDelayedReply(true);
-        ClientIdentifier *identifier = new ClientIdentifier(this, connection(), message());
-        connect(identifier, &ClientIdentifier::finished,
-                this, &NotificationManager::identifiedGetNotificationsByCategory, Qt::QueuedConnection);
+        it = m_changeSequences.insert(id, ++m_changeSequence);
     }
-    return notificationList;
+    m_changedNotifications.insert(it.value(), id);
 }
 
-void NotificationManager::identifiedGetNotificationsByCategory()
+void NotificationManager::recordRemoval(uint id)
 {
-    ClientIdentifier *identifier = qobject_cast<ClientIdentifier *>(sender());
-    QVariantList arguments(identifier->message().arguments());
-    const QString category = arguments.at(0).toString();
-    NotificationList notificationList = handleGetNotificationsByCategory(identifier->clientPid(), category);
-    if (identifier->message().isReplyRequired()) {
-        QDBusMessage reply = identifier->message().createReply();
-        reply << QVariant::fromValue(notificationList);
-        identifier->connection().send(reply);
+    QHash<uint, quint32>::iterator it = m_changeSequences.find(id);
+    if (it != m_changeSequences.end()) {
+        m_changedNotifications.remove(it.value());
+        m_changeSequences.erase(it);
     }
-    identifier->deleteLater();
-}
 
-NotificationList NotificationManager::handleGetNotificationsByCategory(int clientPid, const QString &category)
-{
-    NOTIFICATIONS_DEBUG("clientPid:" << clientPid << "category:" << category);
-    QList<LipstickNotification *> notificationList;
-    if (processIsPrivileged(clientPid)) {
-        QHash<uint, LipstickNotification *>::const_iterator it = m_notifications.constBegin(),
-                end = m_notifications.constEnd();
-        for ( ; it != end; ++it) {
-            LipstickNotification *notification = it.value();
-            if (notification->category() == category) {
-                notificationList.append(notification);
-            }
-        }
+    m_removalHistory.insert(++m_changeSequence, id);
+    if (m_removalHistory.count() > MaxRemovalHistory) {
+        // Clients which have not seen the forgotten removal have to fetch everything again
+        QMap<quint32, uint>::iterator oldest = m_removalHistory.begin();
+        m_resyncSequence = oldest.key();
+        m_removalHistory.erase(oldest);
     }
-    return NotificationList(notificationList);
 }
 
 QString NotificationManager::systemApplicationName() const
@@ -813,36 +1632,58 @@ uint NotificationManager::nextAvailableNotificationID()
 
 void NotificationManager::removeNotificationsWithCategory(const QString &category)
 {
-    QList<uint> ids;
-    QHash<uint, LipstickNotification *>::const_iterator it = m_notifications.constBegin(), end = m_notifications.constEnd();
-    for ( ; it != end; ++it) {
-        LipstickNotification *notification(it.value());
-        if (notification->category() == category) {
-            ids.append(it.key());
-        }
-    }
-    closeNotifications(ids);
+    closeNotifications(m_categoryIndex.values(category));
 }
 
 void NotificationManager::updateNotificationsWithCategory(const QString &category)
 {
     QList<LipstickNotification *> categoryNotifications;
-
-    QHash<uint, LipstickNotification *>::const_iterator it = m_notifications.constBegin(), end = m_notifications.constEnd();
-    for ( ; it != end; ++it) {
-        LipstickNotification *notification(it.value());
-        if (notification->category() == category) {
-            categoryNotifications.append(notification);
-        }
+    foreach (uint id, m_categoryIndex.values(category)) {
+        categoryNotifications.append(m_notifications.value(id));
     }
 
     foreach (LipstickNotification *notification, categoryNotifications) {
+        const NotificationRecord previousRecord(notificationRecord(notification));
+
         // Mark the notification as restored to avoid showing the preview banner again
         notification->setRestored(true);
 
         // Update the category properties and re-publish
         applyCategoryDefinition(notification);
-        publish(notification, notification->id());
+        publish(notification, notification->id(), &previousRecord);
+    }
+}
+
+void NotificationManager::indexNotification(const LipstickNotification *notification)
+{
+    const uint id(notification->id());
+    const QString owner(notification->owner());
+    const QString category(notification->category());
+
+    QHash<uint, IndexKeys>::iterator it = m_indexKeys.find(id);
+    if (it != m_indexKeys.end()) {
+        if (it->owner == owner && it->category == category) {
+            return;
+        }
+        m_ownerIndex.remove(it->owner, id);
+        m_categoryIndex.remove(it->category, id);
+        it->owner = owner;
+        it->category = category;
+    } else {
+        m_indexKeys.insert(id, IndexKeys { owner, category });
+    }
+
+    m_ownerIndex.insert(owner, id);
+    m_categoryIndex.insert(category, id);
+}
+
+void NotificationManager::unindexNotification(uint id)
+{
+    QHash<uint, IndexKeys>::iterator it = m_indexKeys.find(id);
+    if (it != m_indexKeys.end()) {
+        m_ownerIndex.remove(it->owner, id);
+        m_categoryIndex.remove(it->category, id);
+        m_indexKeys.erase(it);
     }
 }
 
@@ -889,10 +1730,20 @@ void NotificationManager::applyCategoryDefinition(LipstickNotification *notifica
         }
     }
 
+    // Share the names of the known categories with the category definition store
+    QVariantHash::iterator category = hints.find(LipstickNotification::HINT_CATEGORY);
+    if (category != hints.end()) {
+        const QString categoryName(m_categoryDefinitionStore->categoryName(category->toString()));
+        if (!categoryName.isNull()) {
+            *category = categoryName;
+        }
+    }
+
     notification->setHints(hints);
 }
 
-void NotificationManager::publish(const LipstickNotification *notification, uint replacesId)
+void NotificationManager::publish(const LipstickNotification *notification, uint replacesId,
+                                  const NotificationRecord *previousRecord)
 {
     const uint id(notification->id());
     if (id == 0) {
@@ -903,62 +1754,185 @@ void NotificationManager::publish(const LipstickNotification *notification, uint
         return;
     }
 
-    if (replacesId != 0) {
-        // Delete the existing notification from the database
-        deleteNotification(id);
-    }
+    indexNotification(notification);
+    recordChange(id);
 
-    // Add the notification, its actions and its hints to the database
-    execSQL("INSERT INTO notifications VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)",
-            QVariantList() << id << notification->appName() << notification->appIcon() << notification->summary()
-            << notification->body() << notification->expireTimeout() << notification->disambiguatedAppName()
-            << notification->explicitAppName() << notification->appIconOrigin());
+    if (replacesId != 0 && previousRecord) {
+        // A replaced notification expires again only after it has been displayed. Only displayed
+        // notifications have an expiration, so updates to the others are not written here.
+        if (removeExpiration(id)) {
+            execSQL(QStringLiteral("DELETE FROM expiration WHERE id=?"), QVariantList() << id);
+        }
 
-    // every other is identifier and every other the localized name for it
-    bool everySecond = false;
-    QString action;
-    foreach (const QString &actionItem, notification->actions()) {
-        if (everySecond) {
-            if (!action.isEmpty()) {
-                execSQL("INSERT INTO actions VALUES (?, ?, ?)", QVariantList() << id << action << actionItem);
-            }
-        } else {
-            action = actionItem;
+        storeUpdate(notification, *previousRecord);
+    } else {
+        if (replacesId != 0) {
+            // Delete the existing notification from the database
+            deleteNotification(id);
         }
-        everySecond = !everySecond;
+        insertRecord(id, notificationRecord(notification));
     }
 
-    const QVariantHash hints(notification->hints());
-    QVariantHash::const_iterator hit = hints.constBegin(), hend = hints.constEnd();
-    for ( ; hit != hend; ++hit) {
-        execSQL("INSERT INTO hints VALUES (?, ?, ?)", QVariantList() << id << hit.key() << hit.value());
+    NOTIFICATIONS_DEBUG("PUBLISH:" << notification->appName() << notification->appIcon() << notification->summary()
+                        << notification->body() << notification->actions() << notification->hints()
+                        << notification->expireTimeout() << "->" << id);
+    addModification(id);
+    if (replacesId == 0) {
+        emit notificationAdded(id);
+    } else {
+        emit notificationModified(id);
     }
+}
 
-    const QVariantHash internalHints(notification->internalHints());
-    hit = internalHints.constBegin(), hend = internalHints.constEnd();
-    for ( ; hit != hend; ++hit) {
-        execSQL("INSERT INTO internal_hints VALUES (?, ?, ?)", QVariantList() << id << hit.key() << hit.value());
+void NotificationManager::storeUpdate(const LipstickNotification *notification, const NotificationRecord &previousRecord)
+{
+    const uint id(notification->id());
+    QHash<uint, NotificationRecord>::iterator stored = m_progressRecords.find(id);
+    if (notification->hasProgress() && notification->progress() < 1.0) {
+        // Keep intermediate progress in memory until the updates settle
+        if (stored == m_progressRecords.end()) {
+            m_progressRecords.insert(id, previousRecord);
+        }
+        m_progressTimer.start();
+    } else if (stored != m_progressRecords.end()) {
+        // Progress completed, write the final state over the last one written
+        updateRecord(id, stored.value(), notificationRecord(notification));
+        m_progressRecords.erase(stored);
+    } else {
+        // Only write what differs from the stored state
+        updateRecord(id, previousRecord, notificationRecord(notification));
     }
+}
 
-    NOTIFICATIONS_DEBUG("PUBLISH:" << notification->appName() << notification->appIcon() << notification->summary()
-                        << notification->body() << notification->actions() << notification->hints()
-                        << notification->expireTimeout() << "->" << id);
+void NotificationManager::addModification(uint id)
+{
     m_modifiedIds.insert(id);
     if (!m_modificationTimer.isActive()) {
         m_modificationTimer.start();
     }
-    if (replacesId == 0) {
-        emit notificationAdded(id);
-    } else {
-        emit notificationModified(id);
+}
+
+NotificationManager::NotificationRecord NotificationManager::notificationRecord(const LipstickNotification *notification)
+{
+    NotificationRecord record;
+    record.columns << notification->appName() << notification->appIcon() << notification->summary()
+                   << notification->body() << notification->expireTimeout() << notification->disambiguatedAppName()
+                   << notification->explicitAppName() << notification->appIconOrigin()
+                   << static_cast<qint64>(notification->internalTimestamp());
+
+    // every other is identifier and every other the localized name for it
+    const QStringList actions(storedActions(notification->actions()));
+    for (int i = 0; i < actions.count(); i += 2) {
+        record.actions << notification->id() << actions.at(i) << actions.at(i + 1);
+    }
+
+    record.hints = notification->hints();
+    // The timestamp is stored in its own column
+    record.hints.remove(LipstickNotification::HINT_TIMESTAMP);
+    record.internalHints = notification->internalHints();
+    return record;
+}
+
+void NotificationManager::insertRecord(uint id, const NotificationRecord &record)
+{
+    // Add the notification, its actions and its hints to the database
+    execSQL("INSERT INTO notifications VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)", QVariantList() << id << record.columns);
+
+    insertRows(QStringLiteral("actions"), 3, record.actions);
+    updateRows(QStringLiteral("hints"), QStringLiteral("hint"), id, QVariantHash(), record.hints);
+    updateRows(QStringLiteral("internal_hints"), QStringLiteral("hint"), id, QVariantHash(), record.internalHints);
+}
+
+void NotificationManager::updateRecord(uint id, const NotificationRecord &previous, const NotificationRecord &current)
+{
+    static const QStringList columnNames(QStringList() << "app_name" << "app_icon" << "summary" << "body"
+                                         << "expire_timeout" << "disambiguated_app_name" << "explicit_app_name"
+                                         << "app_icon_origin" << "timestamp");
+
+    QStringList assignments;
+    QVariantList values;
+    for (int i = 0; i < columnNames.count(); ++i) {
+        if (previous.columns.value(i) != current.columns.value(i)) {
+            assignments.append(columnNames.at(i) + QStringLiteral("=?"));
+            values.append(current.columns.value(i));
+        }
+    }
+    if (!assignments.isEmpty()) {
+        execSQL(QStringLiteral("UPDATE notifications SET ") + assignments.join(QStringLiteral(", "))
+                + QStringLiteral(" WHERE id=?"), values << id);
+    }
+
+    // Actions are rewritten as a whole to keep them in order
+    if (previous.actions != current.actions) {
+        execSQL(QStringLiteral("DELETE FROM actions WHERE id=?"), QVariantList() << id);
+        insertRows(QStringLiteral("actions"), 3, current.actions);
+    }
+
+    updateRows(QStringLiteral("hints"), QStringLiteral("hint"), id, previous.hints, current.hints);
+    updateRows(QStringLiteral("internal_hints"), QStringLiteral("hint"), id, previous.internalHints,
+               current.internalHints);
+}
+
+void NotificationManager::updateRows(const QString &tableName, const QString &keyColumn, uint id,
+                                     const QVariantHash &previous, const QVariantHash &current)
+{
+    QVariantList removedKeys;
+    QVariantHash::const_iterator it = previous.constBegin(), end = previous.constEnd();
+    for ( ; it != end; ++it) {
+        if (!current.contains(it.key())) {
+            removedKeys.append(it.key());
+        }
+    }
+
+    const int maxKeys = MaxStatementBindValues - 1;
+    for (int first = 0; first < removedKeys.count(); first += maxKeys) {
+        const QVariantList keys(removedKeys.mid(first, maxKeys));
+        QString command(QStringLiteral("DELETE FROM ") + tableName + QStringLiteral(" WHERE id=? AND ") + keyColumn
+                        + QStringLiteral(" IN (?"));
+        for (int i = 1; i < keys.count(); ++i) {
+            command.append(QStringLiteral(", ?"));
+        }
+        command.append(QLatin1Char(')'));
+        execSQL(command, QVariantList() << id << keys);
+    }
+
+    QVariantList rows;
+    for (it = current.constBegin(), end = current.constEnd(); it != end; ++it) {
+        QVariantHash::const_iterator previousValue = previous.constFind(it.key());
+        if (previousValue == previous.constEnd() || previousValue.value() != it.value()) {
+            rows << id << it.key() << it.value();
+        }
     }
+    insertRows(tableName, 3, rows);
 }
 
 void NotificationManager::restoreNotifications(bool update)
 {
+    if (update) {
+        // Only the owner writes and removes image files
+        m_imageStore = new NotificationImageStore(notificationDataPath() + QStringLiteral("/images"));
+    }
+
     if (connectToDatabase()) {
         if (checkTableValidity()) {
-            fetchData(update);
+            m_databaseWriter = new NotificationDatabaseWriter(m_database->databaseName());
+            m_generation = databaseGeneration();
+
+            QElapsedTimer restoreTimer;
+            restoreTimer.start();
+
+            const bool fromSnapshot = loadSnapshot(update);
+            if (!fromSnapshot) {
+                fetchData(update);
+            }
+
+            if (update) {
+                NOTIFICATIONS_DEBUG("Notifications restored:" << m_notifications.count() << "in" << restoreTimer.elapsed()
+                                    << "ms" << (fromSnapshot ? "from snapshot" : "from database"));
+
+                // Images of notifications closed while lipstick was not running
+                m_imageStore->removeUnreferenced();
+            }
         } else {
             m_database->close();
         }
@@ -967,8 +1941,7 @@ void NotificationManager::restoreNotifications(bool update)
 
 bool NotificationManager::connectToDatabase()
 {
-    QString databasePath = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation)
-            + QStringLiteral("/system/privileged/Notifications");
+    QString databasePath = notificationDataPath();
     if (!QDir::root().exists(databasePath)) {
         QDir::root().mkpath(databasePath);
     }
@@ -1028,9 +2001,16 @@ bool NotificationManager::checkTableValidity()
     bool recreateHintsTable = false;
     bool recreateInternalHintsTable = false;
     bool recreateExpirationTable = false;
+    bool recreateGenerationTable = false;
 
     const int databaseVersion(schemaVersion());
 
+    // Migrate in a single transaction, so that an interrupted migration is run again from the start
+    const bool migrating = databaseVersion != 6;
+    if (migrating && !m_database->transaction()) {
+        qWarning() << "Unable to start database migration transaction!" << m_database->lastError();
+    }
+
     if (databaseVersion < 3) {
         // All databases this old should have been migrated already.
         qWarning() << "Removing obsolete notifications";
@@ -1051,23 +2031,50 @@ bool NotificationManager::checkTableValidity()
             }
 
         } else {
-            recreateNotificationsTable = !verifyTableColumns("notifications",
-                                                             QStringList() << "id" << "app_name" << "app_icon" << "summary"
-                                                             << "body" << "expire_timeout" << "disambiguated_app_name"
-                                                             << "explicit_app_name" << "app_icon_origin");
+            QStringList notificationsColumns(QStringList() << "id" << "app_name" << "app_icon" << "summary"
+                                             << "body" << "expire_timeout" << "disambiguated_app_name"
+                                             << "explicit_app_name" << "app_icon_origin");
+            if (databaseVersion >= 6) {
+                notificationsColumns << "timestamp";
+            }
+            recreateNotificationsTable = !verifyTableColumns("notifications", notificationsColumns);
             recreateActionsTable = !verifyTableColumns("actions", QStringList() << "id" << "action" << "display_name");
         }
 
         recreateHintsTable = !verifyTableColumns("hints", QStringList() << "id" << "hint" << "value");
+
+        if (databaseVersion < 6 && !recreateNotificationsTable) {
+            // Move the ISO 8601 timestamps from the hints to an integer column, in milliseconds since epoch.
+            // The timestamps are lost if the hints table is recreated anyway.
+            QSqlQuery query(*m_database);
+            if (query.exec("ALTER TABLE notifications ADD COLUMN timestamp INTEGER")
+                    && (recreateHintsTable
+                        || (query.exec("UPDATE notifications SET timestamp = (SELECT CAST(strftime('%s', value) AS INTEGER) * 1000 "
+                                       "FROM hints WHERE hints.id = notifications.id AND hints.hint = 'x-nemo-timestamp')")
+                            && query.exec("DELETE FROM hints WHERE hint = 'x-nemo-timestamp'")))) {
+                qWarning() << "Converted notification timestamps";
+            } else {
+                qWarning() << "Failed to convert notification timestamps!" << query.lastError();
+                recreateNotificationsTable = true;
+            }
+        }
+
         recreateInternalHintsTable = !verifyTableColumns("internal_hints", QStringList() << "id" << "hint" << "value");
         recreateExpirationTable = !verifyTableColumns("expiration", QStringList() << "id" << "expire_at");
+        recreateGenerationTable = !verifyTableColumns("generation", QStringList() << "value");
+    }
+
+    if (recreateNotificationsTable || recreateActionsTable || recreateHintsTable || recreateInternalHintsTable
+            || recreateExpirationTable || databaseVersion < 6) {
+        // Any existing snapshot no longer matches the database contents
+        recreateGenerationTable = true;
     }
 
     if (recreateNotificationsTable) {
         qWarning() << "Recreating notifications table";
         result &= recreateTable("notifications", "id INTEGER PRIMARY KEY, app_name TEXT, app_icon TEXT, summary TEXT, "
                                                  "body TEXT, expire_timeout INTEGER, disambiguated_app_name TEXT, "
-                                                 "explicit_app_name TEXT, app_icon_origin INTEGER");
+                                                 "explicit_app_name TEXT, app_icon_origin INTEGER, timestamp INTEGER");
     }
     if (recreateActionsTable) {
         qWarning() << "Recreating actions table";
@@ -1085,10 +2092,28 @@ bool NotificationManager::checkTableValidity()
         qWarning() << "Recreating expiration table";
         result &= recreateTable("expiration", "id INTEGER PRIMARY KEY, expire_at INTEGER");
     }
+    if (recreateGenerationTable) {
+        qWarning() << "Recreating generation table";
+        result &= recreateTable("generation", "value INTEGER");
+        // Start from a value no earlier snapshot can have been written with
+        QSqlQuery query(*m_database);
+        query.prepare("INSERT INTO generation VALUES (?)");
+        query.addBindValue(QDateTime::currentDateTimeUtc().toMSecsSinceEpoch());
+        result &= query.exec();
+    }
 
-    if (result && databaseVersion != 4) {
-        if (!setSchemaVersion(4)) {
+    if (migrating) {
+        if (result && !setSchemaVersion(6)) {
             qWarning() << "Unable to set database schema version!";
+            result = false;
+        }
+
+        if (result) {
+            result = m_database->commit();
+        }
+        if (!result) {
+            qWarning() << "Database migration failed, leaving the database unchanged" << m_database->lastError();
+            m_database->rollback();
         }
     }
     return result;
@@ -1152,133 +2177,249 @@ bool NotificationManager::recreateTable(const QString &tableName, const QString
 
 void NotificationManager::fetchData(bool update)
 {
-    // Gather actions for each notification
-    QSqlQuery actionsQuery("SELECT * FROM actions", *m_database);
-    QSqlRecord actionsRecord = actionsQuery.record();
-    int actionsTableIdIndex = actionsRecord.indexOf("id");
-    int actionsTableActionIndex = actionsRecord.indexOf("action");
-    int actionsTableNameIndex = actionsRecord.indexOf("display_name");
-
-    QHash<uint, QStringList> actions;
-    while (actionsQuery.next()) {
-        const uint id = actionsQuery.value(actionsTableIdIndex).toUInt();
-        actions[id].append(actionsQuery.value(actionsTableActionIndex).toString());
-        actions[id].append(actionsQuery.value(actionsTableNameIndex).toString());
-    }
-
-    // Gather hints for each notification
-    QSqlQuery hintsQuery("SELECT * FROM hints", *m_database);
-    QSqlRecord hintsRecord = hintsQuery.record();
-    int hintsTableIdIndex = hintsRecord.indexOf("id");
-    int hintsTableHintIndex = hintsRecord.indexOf("hint");
-    int hintsTableValueIndex = hintsRecord.indexOf("value");
-    QHash<uint, QVariantHash> hints;
-
-    while (hintsQuery.next()) {
-        const uint id = hintsQuery.value(hintsTableIdIndex).toUInt();
-        const QString hintName(hintsQuery.value(hintsTableHintIndex).toString());
-        const QVariant hintValue(hintsQuery.value(hintsTableValueIndex));
-
-        QVariant value;
-        if (hintName == LipstickNotification::HINT_TIMESTAMP) {
-            // Timestamps in the DB are already UTC but not marked as such, so they will
-            // be converted again unless specified to be UTC
-            QDateTime timestamp(QDateTime::fromString(hintValue.toString(), Qt::ISODate));
-            timestamp.setTimeSpec(Qt::UTC);
-            value = timestamp.toString(Qt::ISODate);
-        } else {
-            value = hintValue;
+    QList<RestoredNotification> restoredNotifications;
+
+    // Stream the rows of all tables in a single pass, grouped by notification ID. The notification
+    // row comes first, followed by its actions in insertion order, hints, internal hints and expiration.
+    QSqlQuery query(*m_database);
+    query.setForwardOnly(true);
+    query.exec("SELECT id, 0 AS kind, 0 AS seq, app_name, explicit_app_name, disambiguated_app_name, app_icon, "
+               "app_icon_origin, summary, body, expire_timeout, timestamp FROM notifications "
+               "UNION ALL SELECT id, 1, rowid, action, display_name, NULL, NULL, NULL, NULL, NULL, NULL, NULL FROM actions "
+               "UNION ALL SELECT id, 2, 0, hint, value, NULL, NULL, NULL, NULL, NULL, NULL, NULL FROM hints "
+               "UNION ALL SELECT id, 3, 0, hint, value, NULL, NULL, NULL, NULL, NULL, NULL, NULL FROM internal_hints "
+               "UNION ALL SELECT id, 4, 0, expire_at, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL FROM expiration "
+               "ORDER BY id, kind, seq");
+    if (query.lastError().isValid()) {
+        qWarning() << "Unable to restore notifications:" << query.lastError().text();
+    }
+
+    enum RowKind { NotificationRow, ActionRow, HintRow, InternalHintRow, ExpirationRow };
+
+    // Properties of the notification currently being restored
+    uint id = 0;
+    bool exists = false;
+    QString appName;
+    QString explicitAppName;
+    QString disambiguatedAppName;
+    QString appIcon;
+    int appIconOrigin = 0;
+    QString summary;
+    QString body;
+    int expireTimeout = -1;
+    QVariant timestamp;
+    QStringList notificationActions;
+    QVariantHash notificationHints;
+    QVariantHash notificationInternalHints;
+    qint64 expireAt = 0;
+
+    bool more = query.next();
+    while (more) {
+        const uint rowId = query.value(0).toUInt();
+        if (rowId != id) {
+            id = rowId;
+            exists = false;
+            notificationActions.clear();
+            notificationHints.clear();
+            notificationInternalHints.clear();
+            expireAt = 0;
+        }
+
+        switch (query.value(1).toInt()) {
+        case NotificationRow:
+            exists = true;
+            appName = query.value(3).toString();
+            explicitAppName = query.value(4).toString();
+            disambiguatedAppName = query.value(5).toString();
+            appIcon = query.value(6).toString();
+            appIconOrigin = query.value(7).toInt();
+            summary = query.value(8).toString();
+            body = query.value(9).toString();
+            expireTimeout = query.value(10).toInt();
+            timestamp = query.value(11);
+            break;
+        case ActionRow:
+            notificationActions.append(query.value(3).toString());
+            notificationActions.append(query.value(4).toString());
+            break;
+        case HintRow:
+            notificationHints.insert(query.value(3).toString(), query.value(4));
+            break;
+        case InternalHintRow:
+            notificationInternalHints.insert(query.value(3).toString(), query.value(4));
+            break;
+        case ExpirationRow:
+            expireAt = query.value(3).value<qint64>();
+            break;
+        }
+
+        more = query.next();
+        if ((more && query.value(0).toUInt() == id) || !exists) {
+            // More rows for this notification to come, or rows without a notification
+            continue;
+        }
+
+        if (!timestamp.isNull()) {
+            notificationHints.insert(LipstickNotification::HINT_TIMESTAMP, timestamp.value<qint64>());
+        }
+
+        LipstickNotification *notification = new LipstickNotification(appName, explicitAppName, disambiguatedAppName,
+                                                                      id, QString(), summary, body, notificationActions,
+                                                                      notificationHints, expireTimeout, this);
+        notification->setAppIcon(appIcon, appIconOrigin);
+        notification->setInternalHints(notificationInternalHints);
+        restoredNotifications.append(RestoredNotification { notification, expireAt });
+    }
+
+    addRestoredNotifications(restoredNotifications, update);
+}
+
+bool NotificationManager::loadSnapshot(bool update)
+{
+    QFile file(snapshotFileName());
+    if (m_generation < 0 || !file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    uchar *mapping = file.map(0, file.size());
+    if (!mapping) {
+        return false;
+    }
+
+    const QByteArray data(QByteArray::fromRawData(reinterpret_cast<const char *>(mapping), file.size()));
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint64 generation = -1;
+    quint32 count = 0;
+    stream >> magic >> version >> generation >> count;
+    if (stream.status() != QDataStream::Ok || magic != SnapshotMagic || version != SnapshotVersion
+            || generation != m_generation) {
+        NOTIFICATIONS_DEBUG("Snapshot not usable:" << magic << version << generation << m_generation);
+        return false;
+    }
+
+    QList<RestoredNotification> restoredNotifications;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        quint32 id;
+        QString appName;
+        QString explicitAppName;
+        QString disambiguatedAppName;
+        QString appIcon;
+        qint32 appIconOrigin;
+        QString summary;
+        QString body;
+        qint32 expireTimeout;
+        QStringList actions;
+        QVariantHash hints;
+        QVariantHash internalHints;
+        qint64 expireAt;
+        stream >> id >> appName >> explicitAppName >> disambiguatedAppName >> appIcon >> appIconOrigin >> summary
+               >> body >> expireTimeout >> actions >> hints >> internalHints >> expireAt;
+
+        LipstickNotification *notification = new LipstickNotification(appName, explicitAppName, disambiguatedAppName,
+                                                                      id, QString(), summary, body, actions,
+                                                                      hints, expireTimeout, this);
+        notification->setAppIcon(appIcon, appIconOrigin);
+        notification->setInternalHints(internalHints);
+        restoredNotifications.append(RestoredNotification { notification, expireAt });
+    }
+
+    if (stream.status() != QDataStream::Ok || !stream.atEnd()) {
+        qWarning() << "Notification snapshot is corrupted";
+        foreach (const RestoredNotification &restored, restoredNotifications) {
+            delete restored.notification;
         }
-        hints[id].insert(hintName, value);
+        return false;
     }
 
-    // Gather the internal hints
-    QSqlQuery internalHintsQuery("SELECT * FROM internal_hints", *m_database);
-    QSqlRecord internalHintsRecord = internalHintsQuery.record();
-    int internalHintsTableIdIndex = internalHintsRecord.indexOf("id");
-    int internalHintsTableHintIndex = internalHintsRecord.indexOf("hint");
-    int internalHintsTableValueIndex = internalHintsRecord.indexOf("value");
-    QHash<uint, QVariantHash> internalHints;
+    addRestoredNotifications(restoredNotifications, update);
+    return true;
+}
 
-    while (internalHintsQuery.next()) {
-        const uint id = internalHintsQuery.value(internalHintsTableIdIndex).toUInt();
-        const QString hintName(internalHintsQuery.value(internalHintsTableHintIndex).toString());
-        const QVariant hintValue(internalHintsQuery.value(internalHintsTableValueIndex));
+void NotificationManager::saveSnapshot()
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << SnapshotMagic << SnapshotVersion << m_generation << quint32(m_notifications.count());
+
+    foreach (const LipstickNotification *notification, m_notifications) {
+        // Store the values in the form they would be read back from the database
+        QVariantHash hints(storedValues(notification->hints()));
+        if (hints.contains(LipstickNotification::HINT_TIMESTAMP)) {
+            hints.insert(LipstickNotification::HINT_TIMESTAMP, static_cast<qint64>(notification->internalTimestamp()));
+        }
 
-        internalHints[id].insert(hintName, hintValue);
+        stream << quint32(notification->id()) << notification->appName() << notification->explicitAppName()
+               << notification->disambiguatedAppName() << notification->appIcon()
+               << qint32(notification->appIconOrigin()) << notification->summary() << notification->body()
+               << qint32(notification->expireTimeout()) << storedActions(notification->actions()) << hints
+               << storedValues(notification->internalHints()) << m_expirationTimes.value(notification->id());
     }
 
-    // Gather expiration times for displayed notifications
-    QSqlQuery expirationQuery("SELECT * FROM expiration", *m_database);
-    QSqlRecord expirationRecord = expirationQuery.record();
-    int expirationTableIdIndex = expirationRecord.indexOf("id");
-    int expirationTableExpireAtIndex = expirationRecord.indexOf("expire_at");
-    QHash<uint, qint64> expireAt;
-    while (expirationQuery.next()) {
-        const uint id = expirationQuery.value(expirationTableIdIndex).toUInt();
-        expireAt.insert(id, expirationQuery.value(expirationTableExpireAtIndex).value<qint64>());
+    m_databaseWriter->writeFile(snapshotFileName(), data);
+}
+
+QString NotificationManager::snapshotFileName() const
+{
+    return QFileInfo(m_database->databaseName()).absolutePath() + QStringLiteral("/notifications.snapshot");
+}
+
+qint64 NotificationManager::databaseGeneration()
+{
+    QSqlQuery query(*m_database);
+    if (query.exec("SELECT value FROM generation") && query.next()) {
+        return query.value(0).value<qint64>();
     }
+    return -1;
+}
 
+void NotificationManager::addRestoredNotifications(const QList<RestoredNotification> &restoredNotifications,
+                                                   bool update)
+{
     const qint64 currentTime(QDateTime::currentDateTimeUtc().toMSecsSinceEpoch());
     QList<LipstickNotification *> activeNotifications;
     QList<uint> transientIds;
     QList<uint> expiredIds;
-    qint64 nextTimeout = std::numeric_limits<qint64>::max();
-    bool unexpiredRemaining = false;
-
-    // Create the notifications
-    QSqlQuery notificationsQuery("SELECT * FROM notifications", *m_database);
-    QSqlRecord notificationsRecord = notificationsQuery.record();
-    int notificationsTableIdIndex = notificationsRecord.indexOf("id");
-    int notificationsTableAppNameIndex = notificationsRecord.indexOf("app_name");
-    int notificationsTableExplicitAppNameIndex = notificationsRecord.indexOf("explicit_app_name");
-    int notificationsTableDisambiguatedAppNameIndex = notificationsRecord.indexOf("disambiguated_app_name");
-    int notificationsTableAppIconIndex = notificationsRecord.indexOf("app_icon");
-    int notificationsTableAppIconOriginIndex = notificationsRecord.indexOf("app_icon_origin");
-    int notificationsTableSummaryIndex = notificationsRecord.indexOf("summary");
-    int notificationsTableBodyIndex = notificationsRecord.indexOf("body");
-    int notificationsTableExpireTimeoutIndex = notificationsRecord.indexOf("expire_timeout");
-
-    while (notificationsQuery.next()) {
-        const uint id = notificationsQuery.value(notificationsTableIdIndex).toUInt();
-        QString appName = notificationsQuery.value(notificationsTableAppNameIndex).toString();
-        QString explicitAppName = notificationsQuery.value(notificationsTableExplicitAppNameIndex).toString();
-        QString disambiguatedAppName = notificationsQuery.value(notificationsTableDisambiguatedAppNameIndex).toString();
-        QString appIcon = notificationsQuery.value(notificationsTableAppIconIndex).toString();
-        int appIconOrigin = notificationsQuery.value(notificationsTableAppIconOriginIndex).toInt();
-        QString summary = notificationsQuery.value(notificationsTableSummaryIndex).toString();
-        QString body = notificationsQuery.value(notificationsTableBodyIndex).toString();
-        int expireTimeout = notificationsQuery.value(notificationsTableExpireTimeoutIndex).toInt();
-
-        const QStringList &notificationActions = actions[id];
-
-        QVariantHash &notificationHints = hints[id];
-        if (notificationHints.value(LipstickNotification::HINT_TRANSIENT).toBool()) {
+
+    foreach (const RestoredNotification &restored, restoredNotifications) {
+        LipstickNotification *notification = restored.notification;
+        const uint id = notification->id();
+
+        if (notification->isTransient()) {
             // This notification was transient, it should not be restored
-            NOTIFICATIONS_DEBUG("TRANSIENT AT RESTORE:" << appName << appIcon << summary << body << notificationActions
-                                << notificationHints << expireTimeout << "->" << id);
+            NOTIFICATIONS_DEBUG("TRANSIENT AT RESTORE:" << notification->appName() << notification->appIcon()
+                                << notification->summary() << notification->body() << notification->actions()
+                                << notification->hints() << notification->expireTimeout() << "->" << id);
             transientIds.append(id);
+            delete notification;
             continue;
         }
 
         bool expired = false;
-        if (update && expireAt.contains(id)) {
-            const qint64 expiry(expireAt.value(id));
-            if (expiry <= currentTime) {
+        if (update && restored.expireAt != 0) {
+            if (restored.expireAt <= currentTime) {
                 expired = true;
             } else {
-                nextTimeout = qMin(expiry, nextTimeout);
-                unexpiredRemaining = true;
+                addExpiration(id, restored.expireAt);
             }
         }
 
-        LipstickNotification *notification = new LipstickNotification(appName, explicitAppName, disambiguatedAppName,
-                                                                      id, QString(), summary, body, notificationActions,
-                                                                      notificationHints, expireTimeout, this);
-        notification->setAppIcon(appIcon, appIconOrigin);
-        notification->setInternalHints(internalHints[id]);
         notification->setRestored(true);
         m_notifications.insert(id, notification);
+        indexNotification(notification);
+        recordChange(id);
+
+        if (m_imageStore) {
+            const QString imageKey = m_imageStore->keyForUrl(
+                        notification->hints().value(LipstickNotification::HINT_IMAGE_PATH).toString());
+            if (!imageKey.isEmpty()) {
+                m_imageStore->addReference(id, imageKey);
+            }
+        }
 
         if (id > m_previousNotificationID) {
             // Use the highest notification ID found as the previous notification ID
@@ -1288,17 +2429,16 @@ void NotificationManager::fetchData(bool update)
         if (!expired) {
             activeNotifications.append(notification);
         } else {
-            NOTIFICATIONS_DEBUG("EXPIRED AT RESTORE:" << appName << appIcon << summary << body << notificationActions
-                                << notificationHints << expireTimeout << "->" << id);
+            NOTIFICATIONS_DEBUG("EXPIRED AT RESTORE:" << notification->appName() << notification->appIcon()
+                                << notification->summary() << notification->body() << notification->actions()
+                                << notification->hints() << notification->expireTimeout() << "->" << id);
             expiredIds.append(id);
         }
     }
 
     if (update) {
         // Remove notifications no longer required
-        foreach (uint id, transientIds) {
-            deleteNotification(id);
-        }
+        deleteNotifications(transientIds);
     }
 
     int cullCount(activeNotifications.count() - MaxNotificationRestoreCount);
@@ -1307,11 +2447,10 @@ void NotificationManager::fetchData(bool update)
         std::sort(activeNotifications.begin(), activeNotifications.end(), notificationReverseOrder);
 
         foreach (LipstickNotification *n, activeNotifications) {
-            const QVariant userRemovable = n->hints().value(LipstickNotification::HINT_USER_REMOVABLE);
-            if (!userRemovable.isValid() || userRemovable.toBool()) {
+            if (n->isUserRemovableByHint()) {
                 const uint id = n->id();
                 NOTIFICATIONS_DEBUG("CULLED AT RESTORE:" << n->appName() << n->appIcon() << n->summary() << n->body()
-                                    << actions[id] << hints[id] << n->expireTimeout() << "->" << id);
+                                    << n->actions() << n->hints() << n->expireTimeout() << "->" << id);
                 expiredIds.append(id);
 
                 if (--cullCount == 0) {
@@ -1323,12 +2462,7 @@ void NotificationManager::fetchData(bool update)
 
     if (update) {
         closeNotifications(expiredIds, NotificationExpired);
-
-        m_nextExpirationTime = unexpiredRemaining ? nextTimeout : 0;
-        if (m_nextExpirationTime) {
-            const qint64 nextTriggerInterval(m_nextExpirationTime - currentTime);
-            m_expirationTimer.start(static_cast<int>(std::min<qint64>(nextTriggerInterval, std::numeric_limits<int>::max())));
-        }
+        scheduleExpiration(currentTime);
     }
 
     foreach (LipstickNotification *n, m_notifications) {
@@ -1337,22 +2471,29 @@ void NotificationManager::fetchData(bool update)
         connect(n, SIGNAL(removeRequested()), this, SLOT(removeNotificationIfUserRemovable()), Qt::QueuedConnection);
 #ifdef DEBUG_NOTIFICATIONS
         const uint id = n->id();
-        NOTIFICATIONS_DEBUG("RESTORED:" << n->appName() << n->appIcon() << n->summary() << n->body() << actions[id]
-                            << hints[id] << n->expireTimeout() << "->" << id);
+        NOTIFICATIONS_DEBUG("RESTORED:" << n->appName() << n->appIcon() << n->summary() << n->body() << n->actions()
+                            << n->hints() << n->expireTimeout() << "->" << id);
 #endif
     }
-
-    if (update) {
-        qWarning() << "Notifications restored:" << m_notifications.count();
-    }
 }
 
 void NotificationManager::commit()
 {
     // Any aditional rules about when database commits are allowed can be added here
-    if (!m_committed) {
-        m_database->commit();
-        m_committed = true;
+    if (m_databaseWriter) {
+        // The snapshot reflects the notifications in memory, so the database has to match them
+        writeProgressUpdates();
+
+        if (m_snapshotOutdated) {
+            // Advance the generation in the same transaction as the modifications it covers
+            ++m_generation;
+            m_databaseWriter->execSQL(QStringLiteral("UPDATE generation SET value=?"), QVariantList() << m_generation);
+            m_databaseWriter->commit();
+            saveSnapshot();
+            m_snapshotOutdated = false;
+        } else {
+            m_databaseWriter->commit();
+        }
     }
 
     qDeleteAll(m_removedNotifications);
@@ -1361,29 +2502,37 @@ void NotificationManager::commit()
 
 void NotificationManager::execSQL(const QString &command, const QVariantList &args)
 {
-    if (!m_database->isOpen()) {
+    if (!m_databaseWriter) {
         return;
     }
 
-    if (m_committed) {
-        m_committed = false;
-        m_database->transaction();
-    }
+    m_databaseWriter->execSQL(command, args);
+    m_snapshotOutdated = true;
 
-    QSqlQuery query(*m_database);
-    query.prepare(command);
+    m_databaseCommitTimer.start();
+}
+
+void NotificationManager::insertRows(const QString &tableName, int columnCount, const QVariantList &values)
+{
+    const int maxRows = MaxStatementBindValues / columnCount;
+    const int rowCount = values.count() / columnCount;
 
-    foreach(const QVariant &arg, args) {
-        query.addBindValue(arg);
+    QString row(QStringLiteral("(?"));
+    for (int column = 1; column < columnCount; ++column) {
+        row.append(QStringLiteral(", ?"));
     }
+    row.append(QLatin1Char(')'));
 
-    query.exec();
+    for (int firstRow = 0; firstRow < rowCount; firstRow += maxRows) {
+        const int rows = qMin(maxRows, rowCount - firstRow);
 
-    if (query.lastError().isValid()) {
-        NOTIFICATIONS_DEBUG(command << args << query.lastError());
-    }
+        QString command(QStringLiteral("INSERT OR REPLACE INTO ") + tableName + QStringLiteral(" VALUES ") + row);
+        for (int i = 1; i < rows; ++i) {
+            command.append(QStringLiteral(", ")).append(row);
+        }
 
-    m_databaseCommitTimer.start();
+        execSQL(command, values.mid(firstRow * columnCount, rows * columnCount));
+    }
 }
 
 void NotificationManager::invokeAction(const QString &action, const QString &actionText)
@@ -1443,8 +2592,7 @@ void NotificationManager::removeNotificationIfUserRemovable(uint id)
         return;
     }
 
-    QVariant userRemovable = notification->hints().value(LipstickNotification::HINT_USER_REMOVABLE);
-    if (!userRemovable.isValid() || userRemovable.toBool()) {
+    if (notification->isUserRemovableByHint()) {
         // The notification should be removed if user removability is not defined (defaults to true) or is set to true
         CloseNotification(id, NotificationDismissedByUser);
     }
@@ -1454,32 +2602,64 @@ void NotificationManager::expire()
 {
     const qint64 currentTime(QDateTime::currentDateTimeUtc().toMSecsSinceEpoch());
     QList<uint> expiredIds;
-    qint64 nextTimeout = std::numeric_limits<qint64>::max();
-    bool unexpiredRemaining = false;
-
-    QSqlQuery expirationQuery("SELECT * FROM expiration", *m_database);
-    QSqlRecord expirationRecord = expirationQuery.record();
-    int expirationTableIdIndex = expirationRecord.indexOf("id");
-    int expirationTableExpireAtIndex = expirationRecord.indexOf("expire_at");
-    while (expirationQuery.next()) {
-        const uint id = expirationQuery.value(expirationTableIdIndex).toUInt();
-        const qint64 expiry = expirationQuery.value(expirationTableExpireAtIndex).value<qint64>();
-
-        if (expiry <= currentTime) {
-            expiredIds.append(id);
-        } else {
-            nextTimeout = qMin(expiry, nextTimeout);
-            unexpiredRemaining = true;
-        }
+
+    // Pop the due entries from the front of the queue
+    QMultiMap<qint64, uint>::iterator it = m_expirationQueue.begin();
+    while (it != m_expirationQueue.end() && it.key() <= currentTime) {
+        expiredIds.append(it.value());
+        m_expirationTimes.remove(it.value());
+        it = m_expirationQueue.erase(it);
     }
 
     closeNotifications(expiredIds, NotificationExpired);
+    scheduleExpiration(currentTime);
+}
+
+bool NotificationManager::addExpiration(uint id, qint64 expireAt)
+{
+    if (m_expirationTimes.contains(id)) {
+        return false;
+    }
+
+    m_expirationTimes.insert(id, expireAt);
+    m_expirationQueue.insert(expireAt, id);
+    return true;
+}
+
+bool NotificationManager::removeExpiration(uint id)
+{
+    QHash<uint, qint64>::iterator it = m_expirationTimes.find(id);
+    if (it == m_expirationTimes.end()) {
+        return false;
+    }
+
+    m_expirationQueue.remove(it.value(), id);
+    m_expirationTimes.erase(it);
+    return true;
+}
+
+void NotificationManager::scheduleExpiration(qint64 currentTime)
+{
+    if (m_expirationQueue.isEmpty()) {
+        m_expirationTimer.stop();
+        return;
+    }
+
+    const qint64 nextTriggerInterval(qMax<qint64>(m_expirationQueue.firstKey() - currentTime, 0));
+    m_expirationTimer.start(static_cast<int>(std::min<qint64>(nextTriggerInterval, std::numeric_limits<int>::max())));
+}
+
+void NotificationManager::writeProgressUpdates()
+{
+    m_progressTimer.stop();
 
-    m_nextExpirationTime = unexpiredRemaining ? nextTimeout : 0;
-    if (m_nextExpirationTime) {
-        const qint64 nextTriggerInterval(m_nextExpirationTime - currentTime);
-        m_expirationTimer.start(static_cast<int>(std::min<qint64>(nextTriggerInterval, std::numeric_limits<int>::max())));
+    QHash<uint, NotificationRecord>::const_iterator it = m_progressRecords.constBegin();
+    for ( ; it != m_progressRecords.constEnd(); ++it) {
+        if (const LipstickNotification *notification = m_notifications.value(it.key())) {
+            updateRecord(it.key(), it.value(), notificationRecord(notification));
+        }
     }
+    m_progressRecords.clear();
 }
 
 void NotificationManager::reportModifications()
@@ -1498,16 +2678,10 @@ void NotificationManager::removeUserRemovableNotifications()
     QHash<uint, LipstickNotification *>::const_iterator it = m_notifications.constBegin(), end = m_notifications.constEnd();
     for ( ; it != end; ++it) {
         LipstickNotification *notification(it.value());
-        QVariant userRemovable = notification->hints().value(LipstickNotification::HINT_USER_REMOVABLE);
-        if (!userRemovable.isValid() || userRemovable.toBool()) {
+        if (notification->isUserRemovableByHint()) {
             closableNotifications.append(it.key());
         }
     }
 
     closeNotifications(closableNotifications, NotificationDismissedByUser);
-
-    // Remove any remaining notifications
-    foreach(uint id, m_notifications.keys()) {
-        removeNotificationIfUserRemovable(id);
-    }
 }
@@ -21,14 +21,42 @@
 #include <QObject>
 #include <QTimer>
 #include <QSet>
+#include <QHash>
+#include <QMultiMap>
+#include <QThreadPool>
 #include <QDBusContext>
 #include <QDBusConnection>
 #include <QDBusMessage>
 
 class CategoryDefinitionStore;
+class NotificationDatabaseWriter;
+class NotificationImageStore;
 class QSqlDatabase;
 class QDBusPendingCallWatcher;
 
+/*!
+ * The arguments of a Notify() call, as passed in a batch to NotifyMany().
+ */
+struct NotificationRequest
+{
+    QString appName;
+    uint replacesId = 0;
+    QString appIcon;
+    QString summary;
+    QString body;
+    QStringList actions;
+    QVariantHash hints;
+    int expireTimeout = -1;
+};
+
+typedef QList<NotificationRequest> NotificationRequestList;
+
+LIPSTICK_EXPORT QDBusArgument &operator<<(QDBusArgument &argument, const NotificationRequest &request);
+LIPSTICK_EXPORT const QDBusArgument &operator>>(const QDBusArgument &argument, NotificationRequest &request);
+
+Q_DECLARE_METATYPE(NotificationRequest)
+Q_DECLARE_METATYPE(NotificationRequestList)
+
 /*!
  * \class ClientIdentifier
  *
@@ -146,6 +174,26 @@ public:
     uint Notify(const QString &appName, uint replacesId, const QString &appIcon, const QString &summary,
                 const QString &body, const QStringList &actions, const QVariantHash &hints, int expireTimeout);
 
+    /*!
+     * Changes some hints of a notification without resending the rest of it.
+     * The category definition of the notification is not applied again, and
+     * only the changed hints are written to the database.
+     *
+     * \param id the ID of the notification
+     * \param changed the hints to add or change
+     * \param removed the names of the hints to remove
+     */
+    void UpdateHints(uint id, const QVariantHash &changed, const QStringList &removed);
+
+    /*!
+     * Sends a batch of notifications. The calling application is identified once
+     * for the whole batch and the notifications are written in one transaction.
+     *
+     * \param requests the arguments of a Notify() call for each notification
+     * \return the ID of each notification, 0 for the notifications which were rejected
+     */
+    QList<uint> NotifyMany(const NotificationRequestList &requests);
+
     /*!
      * Causes a notification to be forcefully closed and removed from the user's view.
      * It can be used, for example, in the event that what the notification pertains
@@ -157,6 +205,14 @@ public:
      */
     void CloseNotification(uint id, NotificationClosedReason closeReason = CloseNotificationCalled);
 
+    /*!
+     * Closes a batch of notifications as if CloseNotification() was called for each of them.
+     * The NotificationsClosed signal is emitted once for the batch.
+     *
+     * \param ids the IDs of the notifications to be closed
+     */
+    void CloseNotifications(const QList<uint> &ids);
+
     /*!
      * Mark the notification as displayed.  If the notification has an expiry timeout
      * value defined, it will apply from when the notification is marked as displayed.
@@ -192,6 +248,30 @@ public:
      */
     NotificationList GetNotificationsByCategory(const QString &category);
 
+    /*!
+     * Returns the notifications added or modified, and the IDs of the notifications removed,
+     * since a change token returned by an earlier call. The token identifies both the
+     * notification manager instance and the latest change seen. If the token is from another
+     * instance or the changes since it are no longer known, all notifications are returned and
+     * a full resync is required. This requires privileged access rights.
+     *
+     * \param token the change token of the changes the client has seen, 0 to get all notifications
+     * \param removedIds the IDs of the notifications removed since the token
+     * \param currentToken the change token to pass on the next call
+     * \param resyncRequired \c true if the client should replace all its notifications with the ones returned
+     * \return the notifications added or modified since the token
+     */
+    NotificationList GetNotificationsSince(quint64 token, QList<uint> &removedIds, quint64 &currentToken,
+                                           bool &resyncRequired);
+
+    /*!
+     * Returns statistics about the notification service, such as the number of
+     * notifications collapsed because their application exceeded its rate limit.
+     *
+     * \return a map of statistic names to values
+     */
+    QVariantMap GetStatistics();
+
     // App name for system notifications originating from Lipstick itself
     QString systemApplicationName() const;
 
@@ -208,6 +288,15 @@ signals:
      */
     void NotificationClosed(uint id, uint reason);
 
+    /*!
+     * Emitted once when a group of notifications is closed for the same reason.
+     * NotificationClosed() is still emitted for each notification too.
+     *
+     * \param ids The IDs of the notifications that were closed.
+     * \param reason The reason the notifications were closed, as in NotificationClosed().
+     */
+    void NotificationsClosed(const QList<uint> &ids, uint reason);
+
     /*!
      * This signal is emitted when one of the following occurs:
      *   * The user performs some global "invoking" action upon a notification. For instance, clicking somewhere
@@ -228,7 +317,8 @@ signals:
     void notificationAdded(uint id);
 
     /*!
-     * Emitted when a notification is modified.
+     * Emitted when a notification is modified. Internal updates, such as attaching
+     * a converted image, are only reported through notificationsModified().
      *
      * \param id the ID of the modified notification
      */
@@ -249,8 +339,9 @@ signals:
     void notificationRemoved(uint id);
 
     /*!
-     * Emitted when a group of notifications is collectively removed. notificationRemoved() is still
-     * called for each instance too.
+     * Emitted when notifications are removed, with all the notifications removed at once.
+     * Emitted for every removal, before notificationRemoved() is emitted for each instance.
+     * Listeners updating models should use this rather than notificationRemoved().
      *
      * \param ids the IDs of the removed notifications
      */
@@ -276,6 +367,21 @@ private slots:
      */
     void identifiedCloseNotification();
 
+    /*!
+     * D-Bus client that made UpdateHints() call has been identified
+     */
+    void identifiedUpdateHints();
+
+    /*!
+     * D-Bus client that made NotifyMany() call has been identified
+     */
+    void identifiedNotifyMany();
+
+    /*!
+     * D-Bus client that made CloseNotifications() call has been identified
+     */
+    void identifiedCloseNotifications();
+
     /*!
      * D-Bus client that made GetNotifications() call has been identified
      */
@@ -286,6 +392,27 @@ private slots:
      */
     void identifiedGetNotificationsByCategory();
 
+    /*!
+     * D-Bus client that made GetNotificationsSince() call has been identified
+     */
+    void identifiedGetNotificationsSince();
+
+    /*!
+     * Forgets the identity of a D-Bus client that has disconnected.
+     *
+     * \param name the name whose owner changed
+     * \param oldOwner the previous owner of the name
+     * \param newOwner the new owner of the name, empty if the name was released
+     */
+    void handleNameOwnerChanged(const QString &name, const QString &oldOwner, const QString &newOwner);
+
+    /*!
+     * Adds an image written to the image store to the notifications waiting for it.
+     *
+     * \param key the key of the image in the image store
+     */
+    void imageStored(const QString &key);
+
     /*!
      * Removes all notifications with the specified category.
      *
@@ -302,7 +429,7 @@ private slots:
     void updateNotificationsWithCategory(const QString &category);
 
     /*!
-     * Commits the current database transaction, if any.
+     * Queues a commit of the current database transaction, if any.
      * Also destroys any removed notifications.
      */
     void commit();
@@ -330,8 +457,25 @@ private slots:
      */
     void reportModifications();
 
+    /*!
+     * Writes the latest state of notifications whose progress updates have been kept in memory.
+     */
+    void writeProgressUpdates();
+
 private:
     bool isInternalOperation() const;
+
+    /*!
+     * Looks up the pid of the D-Bus client making the current call from the
+     * clients identified earlier.
+     *
+     * \param clientPid set to the pid of the client if it was found
+     * \return \c true if the client has been identified earlier, \c false otherwise
+     */
+    bool cachedClientPid(int *clientPid);
+
+    //! Starts identifying the D-Bus client making the current call, remembering the result
+    ClientIdentifier *identifyClient();
     /*!
      * Actual Notify() work. In case of D-Bus ipc, called after client identification.
      */
@@ -344,6 +488,24 @@ private:
      */
     void handleCloseNotification(int clientPid, uint id, NotificationClosedReason closeReason);
 
+    /*!
+     * Actual UpdateHints() work. In case of D-Bus ipc, called after client identification.
+     *
+     * \return QDBusError::InvalidArgs if the notification does not exist, QDBusError::AccessDenied if
+     * the client is not allowed to make the changes and QDBusError::NoError otherwise
+     */
+    QDBusError::ErrorType handleUpdateHints(int clientPid, uint id, const QVariantHash &changed, const QStringList &removed);
+
+    /*!
+     * Actual NotifyMany() work. In case of D-Bus ipc, called after client identification.
+     */
+    QList<uint> handleNotifyMany(int clientPid, const NotificationRequestList &requests);
+
+    /*!
+     * Actual CloseNotifications() work. In case of D-Bus ipc, called after client identification.
+     */
+    void handleCloseNotifications(int clientPid, const QList<uint> &ids);
+
     /*!
      * Actual GetNotifications() work. In case of D-Bus ipc, called after client identification.
      */
@@ -354,6 +516,23 @@ private:
      */
     NotificationList handleGetNotificationsByCategory(int clientPid, const QString &category);
 
+    /*!
+     * Actual GetNotificationsSince() work. In case of D-Bus ipc, called after client identification.
+     *
+     * \return \c false if the client is not allowed to get the notifications
+     */
+    bool handleGetNotificationsSince(int clientPid, quint64 token, NotificationList *notifications,
+                                     QList<uint> *removedIds, quint64 *currentToken, bool *resyncRequired);
+
+    //! Returns a random non-zero value identifying this instance in change tokens
+    static quint32 createChangeEpoch();
+
+    //! Assigns a new change sequence to an added or modified notification
+    void recordChange(uint id);
+
+    //! Assigns a new change sequence to the removal of a notification
+    void recordRemoval(uint id);
+
     /*!
      * Creates a new notification manager.
      *
@@ -384,12 +563,88 @@ private:
      */
     void applyCategoryDefinition(LipstickNotification *notification) const;
 
+    //! The stored representation of a notification in the database
+    struct NotificationRecord
+    {
+        //! Values of the notifications table columns following the ID
+        QVariantList columns;
+        //! Rows of the actions table
+        QVariantList actions;
+        QVariantHash hints;
+        QVariantHash internalHints;
+    };
+
     /*!
      * Makes a notification known to the system, or updates its properties if already published.
+     *
+     * \param notification the notification to publish
+     * \param replacesId the ID of the notification being updated, or 0 for a new notification
+     * \param previousRecord the stored state of the notification being updated. If given, only
+     *        the differences to it are written to the database.
+     */
+    void publish(const LipstickNotification *notification, uint replacesId,
+                 const NotificationRecord *previousRecord = nullptr);
+
+    /*!
+     * Writes the changes of a published notification to the database. Intermediate
+     * progress updates are kept in memory until the updates settle.
+     *
+     * \param notification the updated notification
+     * \param previousRecord the stored state of the notification before the update
+     */
+    void storeUpdate(const LipstickNotification *notification, const NotificationRecord &previousRecord);
+
+    //! Adds a notification to the next batch of modifications reported
+    void addModification(uint id);
+
+    //! Returns the representation of a notification to be stored in the database
+    static NotificationRecord notificationRecord(const LipstickNotification *notification);
+
+    //! Adds a notification to the database
+    void insertRecord(uint id, const NotificationRecord &record);
+
+    //! Updates a notification in the database, writing only the rows and columns that differ
+    void updateRecord(uint id, const NotificationRecord &previous, const NotificationRecord &current);
+
+    /*!
+     * Brings the key-value rows of a notification in a table from the previous to the current state.
+     *
+     * \param tableName the name of the table
+     * \param keyColumn the name of the key column
+     * \param id the ID of the notification
+     * \param previous the rows currently stored
+     * \param current the rows to be stored
+     */
+    void updateRows(const QString &tableName, const QString &keyColumn, uint id,
+                    const QVariantHash &previous, const QVariantHash &current);
+
+    /*!
+     * Adds a notification to the expiration queue unless it is already queued.
+     *
+     * \param id the ID of the notification
+     * \param expireAt the expiration time, relative to epoch
+     * \return \c true if the notification was added, \c false otherwise
+     */
+    bool addExpiration(uint id, qint64 expireAt);
+
+    /*!
+     * Removes a notification from the expiration queue.
+     *
+     * \param id the ID of the notification
+     * \return \c true if the notification was queued, \c false otherwise
      */
-    void publish(const LipstickNotification *notification, uint replacesId);
+    bool removeExpiration(uint id);
+
+    //! Starts the expiration timer for the first notification in the expiration queue, if any
+    void scheduleExpiration(qint64 currentTime);
+
+    //! Adds a notification to the owner and category indexes, or updates its entries in them
+    void indexNotification(const LipstickNotification *notification);
 
-    //! Restores the notifications from a database on the disk
+    //! Removes a notification from the owner and category indexes
+    void unindexNotification(uint id);
+
+    //! Restores the notifications from a snapshot or a database on the disk
     void restoreNotifications(bool update);
 
     /*!
@@ -404,6 +659,12 @@ private:
      */
     void deleteNotification(uint id);
 
+    /*!
+     * Deletes notifications from the system, without any reporting.
+     * The rows of all the notifications are deleted with one statement per table.
+     */
+    void deleteNotifications(const QList<uint> &ids);
+
     /*!
      * Causes all listed notifications to be forcefully closed and removed from the user's view.
      * The NotificationClosed signal is emitted by this method for each closed notification.
@@ -473,20 +734,90 @@ private:
     //! Fills the notifications hash table with data from the database
     void fetchData(bool update);
 
+    //! A notification read from the disk and the time it expires at, or 0
+    struct RestoredNotification
+    {
+        LipstickNotification *notification;
+        qint64 expireAt;
+    };
+
+    /*!
+     * Fills the notifications hash table from the snapshot file if it matches
+     * the current generation of the database.
+     *
+     * \param update \c true if expired and excess notifications should be removed
+     * \return \c true if the snapshot was used, \c false otherwise
+     */
+    bool loadSnapshot(bool update);
+
+    //! Queues writing the current set of notifications to the snapshot file
+    void saveSnapshot();
+
+    //! Returns the path of the snapshot file
+    QString snapshotFileName() const;
+
+    //! Returns the generation stored in the database, or -1 if not available
+    qint64 databaseGeneration();
+
+    //! Takes the notifications read from the disk into use
+    void addRestoredNotifications(const QList<RestoredNotification> &restoredNotifications, bool update);
+
     /*!
-     * Executes a SQL command in the database. Starts a new transaction if none is active currently, otherwise
-     * the command goes to the active transaction. Restarts the transaction commit timer.
+     * Queues a SQL command for execution in the database writer thread. Starts a new transaction if none is
+     * active currently, otherwise the command goes to the active transaction. Restarts the transaction commit timer.
      * \param command the SQL command
      * \param args list of values to be bound to the positional placeholders ('?' -character) in the command.
      */
     void execSQL(const QString &command, const QVariantList &args = QVariantList());
 
+    /*!
+     * Inserts rows into a database table using as few multi-row INSERT statements as possible.
+     * Rows whose primary key is already present are replaced.
+     *
+     * \param tableName the name of the table
+     * \param columnCount the number of columns in the table
+     * \param values the column values of all rows, one row after another
+     */
+    void insertRows(const QString &tableName, int columnCount, const QVariantList &values);
+
     //! The singleton notification manager instance
     static NotificationManager *s_instance;
 
     //! Hash of all notifications keyed by notification IDs
     QHash<uint, LipstickNotification*> m_notifications;
 
+    //! Pids of identified D-Bus clients keyed by their unique bus names
+    QHash<QString, int> m_clientPids;
+
+    //! Number of D-Bus calls from clients found in and missing from m_clientPids
+    quint64 m_clientPidCacheHits;
+    quint64 m_clientPidCacheMisses;
+
+    //! Threads writing the images of image-data hints to the image store
+    QThreadPool m_imageEncoderPool;
+
+    //! Files of the images received as image-data hints, only in the instance owning the D-Bus service
+    NotificationImageStore *m_imageStore;
+
+    //! Keys of the images being written keyed by the IDs of the notifications waiting for them
+    QHash<uint, QString> m_pendingImages;
+
+    //! The owner and category a notification is indexed with
+    struct IndexKeys
+    {
+        QString owner;
+        QString category;
+    };
+
+    //! Index keys of all notifications keyed by notification IDs
+    QHash<uint, IndexKeys> m_indexKeys;
+
+    //! IDs of notifications keyed by owner
+    QMultiHash<QString, uint> m_ownerIndex;
+
+    //! IDs of notifications keyed by category
+    QMultiHash<QString, uint> m_categoryIndex;
+
     //! Notifications waiting to be destroyed
     QSet<LipstickNotification *> m_removedNotifications;
 
@@ -496,11 +827,17 @@ private:
     //! The category definition store
     CategoryDefinitionStore *m_categoryDefinitionStore;
 
-    //! Database for the notifications
+    //! Database for the notifications, used for reading in the main thread
     QSqlDatabase *m_database;
 
-    //! Whether the current database transaction has been committed to the database
-    bool m_committed;
+    //! Writer thread performing all modifications to the database
+    NotificationDatabaseWriter *m_databaseWriter;
+
+    //! Generation of the database contents, advanced on each commit of modifications
+    qint64 m_generation;
+
+    //! Whether the database has been modified since the snapshot was last written
+    bool m_snapshotOutdated;
 
     //! Timer for triggering the commit of the current database transaction
     QTimer m_databaseCommitTimer;
@@ -508,8 +845,11 @@ private:
     //! Timer for triggering the expiration of displayed notifications
     QTimer m_expirationTimer;
 
-    //! Next trigger time for the expirationTimer, relative to epoch
-    qint64 m_nextExpirationTime;
+    //! IDs of displayed notifications ordered by their expiration time, relative to epoch
+    QMultiMap<qint64, uint> m_expirationQueue;
+
+    //! Expiration times of the notifications in the expiration queue by ID
+    QHash<uint, qint64> m_expirationTimes;
 
     //! IDs of notifications modified since the last report
     QSet<uint> m_modifiedIds;
@@ -517,6 +857,62 @@ private:
     //! Timer for triggering the reporting of modified notifications
     QTimer m_modificationTimer;
 
+    //! Token bucket limiting the rate of notifications from an application
+    struct RateLimit {
+        qreal tokens = 0;
+        //! Time of the last refill in milliseconds since epoch
+        qint64 updated = 0;
+        //! ID of the latest notification created by the application
+        uint latestId = 0;
+        quint64 throttledCount = 0;
+    };
+
+    /*!
+     * Refills the rate limit bucket of an application for the time passed and checks
+     * whether it holds a token. The token is taken by the caller once the notification
+     * has been published.
+     *
+     * \param application the resolved identity of the application
+     * \return \c true if the application may create a new notification, \c false if it is over its limit
+     */
+    bool hasRateLimitToken(const QString &application);
+
+    //! Rate limit buckets keyed by the resolved identity of the applications
+    QHash<QString, RateLimit> m_rateLimits;
+
+    //! Size of the rate limit buckets, zero if rate limiting is disabled
+    int m_rateLimitBurst;
+
+    //! Tokens added to the rate limit buckets per minute
+    int m_rateLimitRate;
+
+    //! Number of notifications collapsed into an earlier one due to rate limiting
+    quint64 m_throttledNotificationCount;
+
+    //! Identifies this instance in the change tokens handed out
+    quint32 m_changeEpoch;
+
+    //! The sequence of the latest change to the notifications
+    quint32 m_changeSequence;
+
+    //! Clients that have seen changes only up to a sequence before this one need a full resync
+    quint32 m_resyncSequence;
+
+    //! IDs of the notifications keyed by the sequence of their latest addition or modification
+    QMap<quint32, uint> m_changedNotifications;
+
+    //! Sequences of the latest addition or modification keyed by notification IDs
+    QHash<uint, quint32> m_changeSequences;
+
+    //! IDs of the removed notifications keyed by the sequence of their removal
+    QMap<quint32, uint> m_removalHistory;
+
+    //! Records last written for notifications with progress updates not yet written, keyed by notification IDs
+    QHash<uint, NotificationRecord> m_progressRecords;
+
+    //! Timer for triggering the writing of settled progress updates
+    QTimer m_progressTimer;
+
 #ifdef UNIT_TEST
     friend class Ut_NotificationManager;
 #endif
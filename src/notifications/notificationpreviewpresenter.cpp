@@ -57,6 +57,7 @@ NotificationPreviewPresenter::NotificationPreviewPresenter(
         ScreenLock *screenLock, NemoDeviceLock::DeviceLock *deviceLock, QObject *parent)
     : QObject(parent)
     , m_window(nullptr)
+    , m_queueSequence(0)
     , m_currentNotification(nullptr)
     , m_notificationFeedbackPlayer(new NotificationFeedbackPlayer(this))
     , m_screenLock(screenLock)
@@ -101,7 +102,10 @@ void NotificationPreviewPresenter::showNextNotification()
 
         setCurrentNotification(nullptr);
     } else {
-        LipstickNotification *notification = m_notificationQueue.takeFirst();
+        QMap<QueueKey, LipstickNotification *>::iterator first = m_notificationQueue.begin();
+        LipstickNotification *notification = first.value();
+        m_notificationQueue.erase(first);
+        m_queuedNotifications.remove(notification->id());
         bool show = notificationShouldBeShown(notification);
 
         if (!show) {
@@ -143,16 +147,28 @@ void NotificationPreviewPresenter::updateNotification(uint id)
 {
     LipstickNotification *notification = NotificationManager::instance()->notification(id);
 
-    // Add the notification to the queue if not already there or the current notification
-    if (notification != nullptr
-            && m_currentNotification != notification
-            && !m_notificationQueue.contains(notification)) {
-        m_notificationQueue.append(notification);
+    if (notification == nullptr || m_currentNotification == notification) {
+        return;
+    }
 
-        // Show the notification if no notification currently being shown
-        if (m_currentNotification == nullptr) {
-            showNextNotification();
-        }
+    // A notification already in the queue is only moved to match its current urgency and priority
+    QHash<uint, QueueKey>::iterator queued = m_queuedNotifications.find(id);
+    const bool alreadyQueued = queued != m_queuedNotifications.end();
+    QueueKey key;
+    if (alreadyQueued) {
+        key = queued.value();
+        m_notificationQueue.remove(key);
+    } else {
+        key.sequence = m_queueSequence++;
+    }
+    key.urgency = notification->urgency();
+    key.priority = notification->priority();
+    m_notificationQueue.insert(key, notification);
+    m_queuedNotifications.insert(id, key);
+
+    // Show the notification if no notification currently being shown
+    if (!alreadyQueued && m_currentNotification == nullptr) {
+        showNextNotification();
     }
 }
 
@@ -161,12 +177,21 @@ void NotificationPreviewPresenter::removeNotification(uint id)
     // Remove the notification from the queue
     LipstickNotification *notification = NotificationManager::instance()->notification(id);
 
-    if (notification != nullptr) {
-        m_notificationQueue.removeAll(notification);
+    QHash<uint, QueueKey>::iterator queued = m_queuedNotifications.find(id);
+    if (queued != m_queuedNotifications.end()) {
+        m_notificationQueue.remove(queued.value());
+        m_queuedNotifications.erase(queued);
+    }
 
-        // If the notification is currently being shown hide it
-        // - the next notification will be shown after the current one has been hidden
-        if (m_currentNotification == notification) {
+    if (notification != nullptr && m_currentNotification == notification) {
+        if (m_currentInBackground) {
+            // The feedback of the notification is stopped as well, so its timeslot is not needed anymore
+            m_backgroundNotificationTimer.stop();
+            setCurrentNotification(nullptr);
+            showNextNotification();
+        } else {
+            // If the notification is currently being shown hide it
+            // - the next notification will be shown after the current one has been hidden
             m_currentNotification = nullptr;
             emit notificationChanged();
         }
@@ -240,6 +265,17 @@ bool NotificationPreviewPresenter::notificationShouldBeShown(LipstickNotificatio
             || (mode == SystemNotificationsDisabled && !notificationIsCritical));
 }
 
+bool NotificationPreviewPresenter::QueueKey::operator<(const QueueKey &other) const
+{
+    if (urgency != other.urgency) {
+        return urgency > other.urgency;
+    }
+    if (priority != other.priority) {
+        return priority > other.priority;
+    }
+    return sequence < other.sequence;
+}
+
 void NotificationPreviewPresenter::setCurrentNotification(LipstickNotification *notification, bool background)
 {
     if (m_currentNotification != notification) {
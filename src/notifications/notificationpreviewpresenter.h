@@ -17,6 +17,8 @@
 
 #include "lipstickglobal.h"
 #include <QObject>
+#include <QHash>
+#include <QMap>
 #include <QTimer>
 
 namespace NemoDeviceLock {
@@ -34,7 +36,9 @@ class ScreenLock;
  * \brief Presents notification previews one at a time.
  *
  * Creates a transparent notification window which can be used to show
- * notification previews.
+ * notification previews. Pending notifications are shown in the order of
+ * their urgency and priority. A notification is queued at most once, so
+ * repeated updates of a pending notification do not cause further previews.
  */
 class LIPSTICK_EXPORT NotificationPreviewPresenter : public QObject
 {
@@ -90,11 +94,27 @@ private:
     //! Sets the given notification as the current notification
     void setCurrentNotification(LipstickNotification *notification, bool background = false);
 
+    //! Position of a notification in the queue
+    struct QueueKey {
+        int urgency;
+        int priority;
+        quint64 sequence;
+
+        //! More urgent notifications sort first, then the ones with higher priority, then the ones queued earlier
+        bool operator<(const QueueKey &other) const;
+    };
+
     //! The notification window
     HomeWindow *m_window;
 
-    //! Notifications to be shown
-    QList<LipstickNotification *> m_notificationQueue;
+    //! Notifications to be shown in the order they should be shown in
+    QMap<QueueKey, LipstickNotification *> m_notificationQueue;
+
+    //! Queue positions of the notifications to be shown keyed by notification ID
+    QHash<uint, QueueKey> m_queuedNotifications;
+
+    //! Sequence number of the next notification to be queued
+    quint64 m_queueSequence;
 
     //! Notification currently being shown
     LipstickNotification *m_currentNotification;
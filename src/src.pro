@@ -45,6 +45,7 @@ PUBLICHEADERS += \
     notifications/notificationmanager.h \
     notifications/lipsticknotification.h \
     notifications/notificationlistmodel.h \
+    notifications/notificationgroupmodel.h \
     notifications/notificationpreviewpresenter.h \
     usbmodeselector.h \
     shutdownscreen.h \
@@ -64,6 +65,8 @@ HEADERS += \
     3rdparty/dbus-gmain/dbus-gmain.h \
     notifications/notificationmanageradaptor.h \
     notifications/categorydefinitionstore.h \
+    notifications/notificationdatabasewriter.h \
+    notifications/notificationimagestore.h \
     notifications/batterynotifier.h \
     notifications/notificationfeedbackplayer.h \
     screenlock/screenlock.h \
@@ -101,7 +104,10 @@ SOURCES += \
     notifications/notificationmanageradaptor.cpp \
     notifications/lipsticknotification.cpp \
     notifications/categorydefinitionstore.cpp \
+    notifications/notificationdatabasewriter.cpp \
+    notifications/notificationimagestore.cpp \
     notifications/notificationlistmodel.cpp \
+    notifications/notificationgroupmodel.cpp \
     notifications/notificationpreviewpresenter.cpp \
     notifications/batterynotifier.cpp \
     screenlock/screenlock.cpp \
@@ -29,6 +29,7 @@ public:
     virtual bool contains(const QString &category, const QString &key);
     virtual QString value(const QString &category, const QString &key);
     virtual QHash<QString, QString> categoryParameters(const QString &category);
+    virtual QString categoryName(const QString &category);
     virtual void updateCategoryDefinitionFileList();
     virtual void updateCategoryDefinitionFile(const QString &path);
 };
@@ -83,6 +84,14 @@ QHash<QString, QString> CategoryDefinitionStoreStub::categoryParameters(const QS
     return stubReturnValue<QHash<QString, QString> >("categoryParameters");
 }
 
+QString CategoryDefinitionStoreStub::categoryName(const QString &category)
+{
+    QList<ParameterBase *> params;
+    params.append( new Parameter<const QString & >(category));
+    stubMethodEntered("categoryName", params);
+    return stubReturnValue<QString>("categoryName");
+}
+
 void CategoryDefinitionStoreStub::updateCategoryDefinitionFileList()
 {
     stubMethodEntered("updateCategoryDefinitionFileList");
@@ -133,6 +142,11 @@ QHash<QString, QString> CategoryDefinitionStore::categoryParameters(const QStrin
     return gCategoryDefinitionStoreStub->categoryParameters(category);
 }
 
+QString CategoryDefinitionStore::categoryName(const QString &category) const
+{
+    return gCategoryDefinitionStoreStub->categoryName(category);
+}
+
 void CategoryDefinitionStore::updateCategoryDefinitionFileList()
 {
     gCategoryDefinitionStoreStub->updateCategoryDefinitionFileList();
@@ -26,7 +26,7 @@ public:
     virtual void NotificationListModelConstructor(QObject *parent);
     virtual void NotificationListModelDestructor();
     virtual void updateNotification(uint id);
-    virtual void removeNotification(uint id);
+    virtual void removeNotifications(const QList<uint> &ids);
 };
 
 // 2. IMPLEMENT STUB
@@ -46,11 +46,11 @@ void NotificationListModelStub::updateNotification(uint id)
     stubMethodEntered("updateNotification", params);
 }
 
-void NotificationListModelStub::removeNotification(uint id)
+void NotificationListModelStub::removeNotifications(const QList<uint> &ids)
 {
     QList<ParameterBase *> params;
-    params.append( new Parameter<uint >(id));
-    stubMethodEntered("removeNotification", params);
+    params.append( new Parameter<const QList<uint> & >(ids));
+    stubMethodEntered("removeNotifications", params);
 }
 
 
@@ -76,9 +76,9 @@ void NotificationListModel::updateNotification(uint id)
     gNotificationListModelStub->updateNotification(id);
 }
 
-void NotificationListModel::removeNotification(uint id)
+void NotificationListModel::removeNotifications(const QList<uint> &ids)
 {
-    gNotificationListModelStub->removeNotification(id);
+    gNotificationListModelStub->removeNotifications(ids);
 }
 
 
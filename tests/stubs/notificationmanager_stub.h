@@ -29,11 +29,16 @@ public:
     virtual QList<uint> notificationIds() const;
     virtual QStringList GetCapabilities();
     virtual uint Notify(const QString &appName, uint replacesId, const QString &appIcon, const QString &summary, const QString &body, const QStringList &actions, const QVariantHash &hints, int expireTimeout);
+    virtual void UpdateHints(uint id, const QVariantHash &changed, const QStringList &removed);
+    virtual QList<uint> NotifyMany(const NotificationRequestList &requests);
     virtual void CloseNotification(uint id, NotificationManager::NotificationClosedReason closeReason);
+    virtual void CloseNotifications(const QList<uint> &ids);
     virtual void markNotificationDisplayed(uint id);
     virtual QString GetServerInformation(QString &name, QString &vendor, QString &version);
     virtual NotificationList GetNotifications(const QString &appName);
     virtual NotificationList GetNotificationsByCategory(const QString &category);
+    virtual NotificationList GetNotificationsSince(quint64 token, QList<uint> &removedIds, quint64 &currentToken, bool &resyncRequired);
+    virtual QVariantMap GetStatistics();
     virtual void removeNotificationsWithCategory(const QString &category);
     virtual void updateNotificationsWithCategory(const QString &category);
     virtual void commit();
@@ -46,8 +51,15 @@ public:
     virtual void NotificationManagerDestructor();
     virtual void identifiedGetNotifications();
     virtual void identifiedGetNotificationsByCategory();
+    virtual void identifiedGetNotificationsSince();
     virtual void identifiedCloseNotification();
+    virtual void identifiedUpdateHints();
+    virtual void identifiedNotifyMany();
+    virtual void identifiedCloseNotifications();
     virtual void identifiedNotify();
+    virtual void handleNameOwnerChanged(const QString &name, const QString &oldOwner, const QString &newOwner);
+    virtual void imageStored(const QString &key);
+    virtual void writeProgressUpdates();
 };
 
 // 2. IMPLEMENT STUB
@@ -94,6 +106,23 @@ uint NotificationManagerStub::Notify(const QString &appName, uint replacesId, co
     return stubReturnValue<uint>("Notify");
 }
 
+void NotificationManagerStub::UpdateHints(uint id, const QVariantHash &changed, const QStringList &removed)
+{
+    QList<ParameterBase *> params;
+    params.append( new Parameter<uint >(id));
+    params.append( new Parameter<QVariantHash >(changed));
+    params.append( new Parameter<QStringList >(removed));
+    stubMethodEntered("UpdateHints", params);
+}
+
+QList<uint> NotificationManagerStub::NotifyMany(const NotificationRequestList &requests)
+{
+    QList<ParameterBase *> params;
+    params.append( new Parameter<NotificationRequestList >(requests));
+    stubMethodEntered("NotifyMany", params);
+    return stubReturnValue<QList<uint> >("NotifyMany");
+}
+
 void NotificationManagerStub::CloseNotification(uint id, NotificationManager::NotificationClosedReason closeReason)
 {
     QList<ParameterBase *> params;
@@ -102,6 +131,13 @@ void NotificationManagerStub::CloseNotification(uint id, NotificationManager::No
     stubMethodEntered("CloseNotification", params);
 }
 
+void NotificationManagerStub::CloseNotifications(const QList<uint> &ids)
+{
+    QList<ParameterBase *> params;
+    params.append( new Parameter<QList<uint> >(ids));
+    stubMethodEntered("CloseNotifications", params);
+}
+
 void NotificationManagerStub::markNotificationDisplayed(uint id)
 {
     QList<ParameterBase *> params;
@@ -135,6 +171,23 @@ NotificationList NotificationManagerStub::GetNotificationsByCategory(const QStri
     return stubReturnValue<NotificationList>("GetNotificationsByCategory");
 }
 
+NotificationList NotificationManagerStub::GetNotificationsSince(quint64 token, QList<uint> &removedIds, quint64 &currentToken, bool &resyncRequired)
+{
+    QList<ParameterBase *> params;
+    params.append( new Parameter<quint64 >(token));
+    params.append( new Parameter<QList<uint> & >(removedIds));
+    params.append( new Parameter<quint64 & >(currentToken));
+    params.append( new Parameter<bool & >(resyncRequired));
+    stubMethodEntered("GetNotificationsSince", params);
+    return stubReturnValue<NotificationList>("GetNotificationsSince");
+}
+
+QVariantMap NotificationManagerStub::GetStatistics()
+{
+    stubMethodEntered("GetStatistics");
+    return stubReturnValue<QVariantMap>("GetStatistics");
+}
+
 void NotificationManagerStub::removeNotificationsWithCategory(const QString &category)
 {
     QList<ParameterBase *> params;
@@ -202,14 +255,51 @@ void NotificationManagerStub::identifiedGetNotificationsByCategory()
 {
 }
 
+void NotificationManagerStub::identifiedGetNotificationsSince()
+{
+}
+
 void NotificationManagerStub::identifiedCloseNotification()
 {
 }
 
+void NotificationManagerStub::identifiedUpdateHints()
+{
+}
+
+void NotificationManagerStub::identifiedNotifyMany()
+{
+}
+
+void NotificationManagerStub::identifiedCloseNotifications()
+{
+}
+
 void NotificationManagerStub::identifiedNotify()
 {
 }
 
+void NotificationManagerStub::handleNameOwnerChanged(const QString &name, const QString &oldOwner, const QString &newOwner)
+{
+    QList<ParameterBase *> params;
+    params.append( new Parameter<QString >(name));
+    params.append( new Parameter<QString >(oldOwner));
+    params.append( new Parameter<QString >(newOwner));
+    stubMethodEntered("handleNameOwnerChanged", params);
+}
+
+void NotificationManagerStub::imageStored(const QString &key)
+{
+    QList<ParameterBase *> params;
+    params.append( new Parameter<QString >(key));
+    stubMethodEntered("imageStored", params);
+}
+
+void NotificationManagerStub::writeProgressUpdates()
+{
+    stubMethodEntered("writeProgressUpdates");
+}
+
 // 3. CREATE A STUB INSTANCE
 NotificationManagerStub gDefaultNotificationManagerStub;
 NotificationManagerStub *gNotificationManagerStub = &gDefaultNotificationManagerStub;
@@ -245,11 +335,26 @@ uint NotificationManager::Notify(const QString &appName, uint replacesId, const
     return gNotificationManagerStub->Notify(appName, replacesId, appIcon, summary, body, actions, hints, expireTimeout);
 }
 
+void NotificationManager::UpdateHints(uint id, const QVariantHash &changed, const QStringList &removed)
+{
+    gNotificationManagerStub->UpdateHints(id, changed, removed);
+}
+
+QList<uint> NotificationManager::NotifyMany(const NotificationRequestList &requests)
+{
+    return gNotificationManagerStub->NotifyMany(requests);
+}
+
 void NotificationManager::CloseNotification(uint id, NotificationClosedReason closeReason)
 {
     gNotificationManagerStub->CloseNotification(id, closeReason);
 }
 
+void NotificationManager::CloseNotifications(const QList<uint> &ids)
+{
+    gNotificationManagerStub->CloseNotifications(ids);
+}
+
 void NotificationManager::markNotificationDisplayed(uint id)
 {
     gNotificationManagerStub->markNotificationDisplayed(id);
@@ -270,6 +375,16 @@ NotificationList NotificationManager::GetNotificationsByCategory(const QString &
     return gNotificationManagerStub->GetNotificationsByCategory(category);
 }
 
+NotificationList NotificationManager::GetNotificationsSince(quint64 token, QList<uint> &removedIds, quint64 &currentToken, bool &resyncRequired)
+{
+    return gNotificationManagerStub->GetNotificationsSince(token, removedIds, currentToken, resyncRequired);
+}
+
+QVariantMap NotificationManager::GetStatistics()
+{
+    return gNotificationManagerStub->GetStatistics();
+}
+
 void NotificationManager::removeNotificationsWithCategory(const QString &category)
 {
     gNotificationManagerStub->removeNotificationsWithCategory(category);
@@ -335,16 +450,51 @@ void NotificationManager::identifiedGetNotificationsByCategory()
     gNotificationManagerStub->identifiedGetNotificationsByCategory();
 }
 
+void NotificationManager::identifiedGetNotificationsSince()
+{
+    gNotificationManagerStub->identifiedGetNotificationsSince();
+}
+
 void NotificationManager::identifiedCloseNotification()
 {
     gNotificationManagerStub->identifiedCloseNotification();
 }
 
+void NotificationManager::identifiedUpdateHints()
+{
+    gNotificationManagerStub->identifiedUpdateHints();
+}
+
+void NotificationManager::identifiedNotifyMany()
+{
+    gNotificationManagerStub->identifiedNotifyMany();
+}
+
+void NotificationManager::identifiedCloseNotifications()
+{
+    gNotificationManagerStub->identifiedCloseNotifications();
+}
+
 void NotificationManager::identifiedNotify()
 {
     gNotificationManagerStub->identifiedNotify();
 }
 
+void NotificationManager::handleNameOwnerChanged(const QString &name, const QString &oldOwner, const QString &newOwner)
+{
+    gNotificationManagerStub->handleNameOwnerChanged(name, oldOwner, newOwner);
+}
+
+void NotificationManager::imageStored(const QString &key)
+{
+    gNotificationManagerStub->imageStored(key);
+}
+
+void NotificationManager::writeProgressUpdates()
+{
+    gNotificationManagerStub->writeProgressUpdates();
+}
+
 void ClientIdentifier::getPidReply(QDBusPendingCallWatcher *getPidWatcher)
 {
     Q_UNUSED(getPidWatcher);
@@ -31,6 +31,11 @@ public:
     virtual uint Notify(const QString &app_name, uint replaces_id, const QString &app_icon, const QString &summary, const QString &body, const QStringList &actions, const QVariantHash &hints, int expire_timeout);
     virtual NotificationList GetNotifications(const QString &app_name);
     virtual NotificationList GetNotificationsByCategory(const QString &category);
+    virtual NotificationList GetNotificationsSince(qulonglong token, QList<uint> &removed_ids, qulonglong &current_token, bool &resync_required);
+    virtual QVariantMap GetStatistics();
+    virtual void UpdateHints(uint id, const QVariantHash &changed, const QStringList &removed);
+    virtual QList<uint> NotifyMany(const NotificationRequestList &notifications);
+    virtual void CloseNotifications(const QList<uint> &ids);
 };
 
 // 2. IMPLEMENT STUB
@@ -98,6 +103,47 @@ NotificationList NotificationManagerAdaptorStub::GetNotificationsByCategory(cons
     return stubReturnValue<NotificationList >("GetNotificationsByCategory");
 }
 
+NotificationList NotificationManagerAdaptorStub::GetNotificationsSince(qulonglong token, QList<uint> &removed_ids, qulonglong &current_token, bool &resync_required)
+{
+    QList<ParameterBase *> params;
+    params.append( new Parameter<qulonglong >(token));
+    params.append( new Parameter<QList<uint> & >(removed_ids));
+    params.append( new Parameter<qulonglong & >(current_token));
+    params.append( new Parameter<bool & >(resync_required));
+    stubMethodEntered("GetNotificationsSince", params);
+    return stubReturnValue<NotificationList >("GetNotificationsSince");
+}
+
+QVariantMap NotificationManagerAdaptorStub::GetStatistics()
+{
+    stubMethodEntered("GetStatistics");
+    return stubReturnValue<QVariantMap>("GetStatistics");
+}
+
+void NotificationManagerAdaptorStub::UpdateHints(uint id, const QVariantHash &changed, const QStringList &removed)
+{
+    QList<ParameterBase *> params;
+    params.append( new Parameter<uint >(id));
+    params.append( new Parameter<const QVariantHash & >(changed));
+    params.append( new Parameter<const QStringList & >(removed));
+    stubMethodEntered("UpdateHints", params);
+}
+
+QList<uint> NotificationManagerAdaptorStub::NotifyMany(const NotificationRequestList &notifications)
+{
+    QList<ParameterBase *> params;
+    params.append( new Parameter<NotificationRequestList >(notifications));
+    stubMethodEntered("NotifyMany", params);
+    return stubReturnValue<QList<uint> >("NotifyMany");
+}
+
+void NotificationManagerAdaptorStub::CloseNotifications(const QList<uint> &ids)
+{
+    QList<ParameterBase *> params;
+    params.append( new Parameter<QList<uint> >(ids));
+    stubMethodEntered("CloseNotifications", params);
+}
+
 // 3. CREATE A STUB INSTANCE
 NotificationManagerAdaptorStub gDefaultNotificationManagerAdaptorStub;
 NotificationManagerAdaptorStub *gNotificationManagerAdaptorStub = &gDefaultNotificationManagerAdaptorStub;
@@ -144,5 +190,30 @@ NotificationList NotificationManagerAdaptor::GetNotificationsByCategory(const QS
     return gNotificationManagerAdaptorStub->GetNotificationsByCategory(category);
 }
 
+NotificationList NotificationManagerAdaptor::GetNotificationsSince(qulonglong token, QList<uint> &removed_ids, qulonglong &current_token, bool &resync_required)
+{
+    return gNotificationManagerAdaptorStub->GetNotificationsSince(token, removed_ids, current_token, resync_required);
+}
+
+QVariantMap NotificationManagerAdaptor::GetStatistics()
+{
+    return gNotificationManagerAdaptorStub->GetStatistics();
+}
+
+void NotificationManagerAdaptor::UpdateHints(uint id, const QVariantHash &changed, const QStringList &removed)
+{
+    gNotificationManagerAdaptorStub->UpdateHints(id, changed, removed);
+}
+
+QList<uint> NotificationManagerAdaptor::NotifyMany(const NotificationRequestList &notifications)
+{
+    return gNotificationManagerAdaptorStub->NotifyMany(notifications);
+}
+
+void NotificationManagerAdaptor::CloseNotifications(const QList<uint> &ids)
+{
+    gNotificationManagerAdaptorStub->CloseNotifications(ids);
+}
+
 
 #endif
@@ -1,10 +1,12 @@
 TEMPLATE = subdirs
 SUBDIRS = \
+          ut_categorydefinitionstore \
           ut_closeeventeater \
           ut_launchermodel \
           ut_lipsticksettings \
           ut_lipsticknotification \
           ut_notificationfeedbackplayer \
+          ut_notificationgroupmodel \
           ut_notificationlistmodel \
           ut_notificationmanager \
           ut_notificationpreviewpresenter \
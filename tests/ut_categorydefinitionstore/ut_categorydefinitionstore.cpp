@@ -0,0 +1,178 @@
+/***************************************************************************
+**
+** Copyright (c) 2021 Jolla Ltd.
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#include <QtTest/QtTest>
+#include "ut_categorydefinitionstore.h"
+#include "categorydefinitionstore.h"
+
+void Ut_CategoryDefinitionStore::init()
+{
+    m_directory = new QTemporaryDir;
+    QVERIFY(m_directory->isValid());
+
+    writeDefinition("x-test.im", "appName=Messages\nx-nemo-priority=120\nx-nemo-feedback=chat, chat_exists\n");
+    writeDefinition("x-test.email", "appName=Email\nx-nemo-priority=120\n");
+}
+
+void Ut_CategoryDefinitionStore::cleanup()
+{
+    delete m_directory;
+    m_directory = 0;
+}
+
+void Ut_CategoryDefinitionStore::writeDefinition(const QString &category, const QByteArray &contents)
+{
+    QFile file(m_directory->path() + "/" + category + ".conf");
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write(contents);
+}
+
+void Ut_CategoryDefinitionStore::testLookups()
+{
+    CategoryDefinitionStore store(m_directory->path());
+    QVERIFY(store.categoryDefinitionExists("x-test.im"));
+    QVERIFY(!store.categoryDefinitionExists("x-test.missing"));
+
+    QCOMPARE(store.allKeys("x-test.email").toSet(), QSet<QString>() << "appName" << "x-nemo-priority");
+    QVERIFY(store.allKeys("x-test.missing").isEmpty());
+
+    QVERIFY(store.contains("x-test.im", "appName"));
+    QVERIFY(!store.contains("x-test.im", "body"));
+    QVERIFY(!store.contains("x-test.missing", "appName"));
+
+    QCOMPARE(store.value("x-test.im", "appName"), QString("Messages"));
+    QCOMPARE(store.value("x-test.im", "x-nemo-feedback"), QString("chat,chat_exists"));
+    QVERIFY(store.value("x-test.im", "body").isNull());
+    QVERIFY(store.value("x-test.missing", "appName").isNull());
+
+    const QHash<QString, QString> parameters(store.categoryParameters("x-test.im"));
+    QCOMPARE(parameters.count(), 3);
+    QCOMPARE(parameters.value("x-nemo-priority"), QString("120"));
+    QVERIFY(store.categoryParameters("x-test.missing").isEmpty());
+}
+
+void Ut_CategoryDefinitionStore::testInvalidDefinitionsAreIgnored()
+{
+    writeDefinition("x-test.empty", QByteArray());
+    writeDefinition("x-test.large", "appName=" + QByteArray(40000, 'a') + "\n");
+
+    CategoryDefinitionStore store(m_directory->path());
+    QVERIFY(!store.categoryDefinitionExists("x-test.empty"));
+    QVERIFY(!store.categoryDefinitionExists("x-test.large"));
+    QVERIFY(store.categoryDefinitionExists("x-test.im"));
+}
+
+void Ut_CategoryDefinitionStore::testDefinitionsAreShared()
+{
+    CategoryDefinitionStore store(m_directory->path());
+
+    // Equal keys and values of different definitions share their data
+    const QHash<QString, QString> im(store.categoryParameters("x-test.im"));
+    const QHash<QString, QString> email(store.categoryParameters("x-test.email"));
+    QCOMPARE(im.value("x-nemo-priority").constData(), email.value("x-nemo-priority").constData());
+    QCOMPARE(im.find("appName").key().constData(), email.find("appName").key().constData());
+
+    // Returned parameters are not copied
+    QVERIFY(store.categoryParameters("x-test.im").isSharedWith(im));
+
+    // Category names are returned as stored, unknown categories are not kept
+    const QString category(store.categoryName(QString("x-test.") + "im"));
+    QCOMPARE(category, QString("x-test.im"));
+    QCOMPARE(category.constData(), store.categoryName("x-test.im").constData());
+    QVERIFY(store.categoryName("x-test.missing").isNull());
+}
+
+void Ut_CategoryDefinitionStore::testDefinitionChanges()
+{
+    CategoryDefinitionStore store(m_directory->path());
+    QSignalSpy modifiedSpy(&store, SIGNAL(categoryDefinitionModified(QString)));
+    QSignalSpy uninstalledSpy(&store, SIGNAL(categoryDefinitionUninstalled(QString)));
+
+    writeDefinition("x-test.im", "appName=Chat\n");
+    store.updateCategoryDefinitionFile(m_directory->path() + "/x-test.im.conf");
+    QCOMPARE(modifiedSpy.count(), 1);
+    QCOMPARE(modifiedSpy.last().at(0).toString(), QString("x-test.im"));
+    QCOMPARE(store.value("x-test.im", "appName"), QString("Chat"));
+    QVERIFY(!store.contains("x-test.im", "x-nemo-priority"));
+
+    // A definition which is no longer valid is removed
+    writeDefinition("x-test.im", QByteArray());
+    store.updateCategoryDefinitionFile(m_directory->path() + "/x-test.im.conf");
+    QCOMPARE(modifiedSpy.count(), 2);
+    QVERIFY(!store.categoryDefinitionExists("x-test.im"));
+
+    writeDefinition("x-test.im", "appName=Chat\n");
+    store.updateCategoryDefinitionFile(m_directory->path() + "/x-test.im.conf");
+    QCOMPARE(modifiedSpy.count(), 3);
+    QCOMPARE(store.value("x-test.im", "appName"), QString("Chat"));
+
+    writeDefinition("x-test.im", "appName=" + QByteArray(40000, 'a') + "\n");
+    store.updateCategoryDefinitionFile(m_directory->path() + "/x-test.im.conf");
+    QCOMPARE(modifiedSpy.count(), 4);
+    QVERIFY(!store.categoryDefinitionExists("x-test.im"));
+
+    // Invalid definitions which are not stored are not reported
+    store.updateCategoryDefinitionFile(m_directory->path() + "/x-test.im.conf");
+    QCOMPARE(modifiedSpy.count(), 4);
+
+    writeDefinition("x-test.sms", "appName=SMS\n");
+    QVERIFY(QFile::remove(m_directory->path() + "/x-test.email.conf"));
+    store.updateCategoryDefinitionFileList();
+    QVERIFY(store.categoryDefinitionExists("x-test.sms"));
+    QVERIFY(!store.categoryDefinitionExists("x-test.email"));
+    QCOMPARE(uninstalledSpy.count(), 1);
+    QCOMPARE(uninstalledSpy.last().at(0).toString(), QString("x-test.email"));
+}
+
+void Ut_CategoryDefinitionStore::testNumberOfDefinitionsIsLimited()
+{
+    writeDefinition("x-test.sms", "appName=SMS\n");
+
+    CategoryDefinitionStore store(m_directory->path(), 2);
+    QVERIFY(store.categoryDefinitionExists("x-test.email"));
+    QVERIFY(store.categoryDefinitionExists("x-test.im"));
+    QVERIFY(!store.categoryDefinitionExists("x-test.sms"));
+
+    // Changes to the skipped definitions do not exceed the limit
+    writeDefinition("x-test.sms", "appName=Messages\n");
+    store.updateCategoryDefinitionFile(m_directory->path() + "/x-test.sms.conf");
+    QVERIFY(!store.categoryDefinitionExists("x-test.sms"));
+}
+
+void Ut_CategoryDefinitionStore::benchmarkNotifyLookups()
+{
+    for (int i = 0; i < 100; ++i) {
+        writeDefinition(QString("x-test.category%1").arg(i),
+                        QString("appName=App %1\napp_icon=icon-%1\nx-nemo-priority=%2\nx-nemo-feedback=chat\n")
+                        .arg(i).arg(100 + i % 3).toUtf8());
+    }
+
+    CategoryDefinitionStore store(m_directory->path(), 200);
+    QStringList categories;
+    for (int i = 0; i < 100; ++i) {
+        categories.append(QString("x-test.category%1").arg((i * 37) % 100));
+    }
+
+    // The lookups done by NotificationManager for each notification
+    int count = 0;
+    QBENCHMARK {
+        foreach (const QString &category, categories) {
+            const QHash<QString, QString> parameters(store.categoryParameters(category));
+            count += parameters.count();
+        }
+    }
+    QVERIFY(count > 0);
+}
+
+QTEST_MAIN(Ut_CategoryDefinitionStore)
@@ -0,0 +1,40 @@
+/***************************************************************************
+**
+** Copyright (c) 2021 Jolla Ltd.
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+#ifndef UT_CATEGORYDEFINITIONSTORE_H
+#define UT_CATEGORYDEFINITIONSTORE_H
+
+#include <QObject>
+#include <QTemporaryDir>
+
+class Ut_CategoryDefinitionStore : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void testLookups();
+    void testInvalidDefinitionsAreIgnored();
+    void testDefinitionsAreShared();
+    void testDefinitionChanges();
+    void testNumberOfDefinitionsIsLimited();
+    void benchmarkNotifyLookups();
+
+private:
+    void writeDefinition(const QString &category, const QByteArray &contents);
+
+    QTemporaryDir *m_directory;
+};
+
+#endif
@@ -18,6 +18,8 @@
 #include "lipsticknotification.h"
 #include "notificationmanager_stub.h"
 
+#include <malloc.h>
+
 void Ut_Notification::testGettersAndSetters()
 {
     QString appName = "appName1";
@@ -198,6 +200,45 @@ void Ut_Notification::testSignals()
     QCOMPARE(urgencySpy.count(), 1);
 }
 
+void Ut_Notification::testHotHints()
+{
+    QVariantHash hints;
+    LipstickNotification n1(QString(), QString(), QString(), 1, QString(), QString(), QString(), QStringList(), hints, 0);
+    QCOMPARE(n1.urgency(), static_cast<int>(LipstickNotification::Normal));
+    QCOMPARE(n1.priority(), 0);
+    QVERIFY(!n1.isTransient());
+    QVERIFY(n1.isUserRemovableByHint());
+    QVERIFY(!n1.hasProgress());
+    QVERIFY(n1.category().isEmpty());
+    QVERIFY(n1.owner().isEmpty());
+
+    hints.insert(LipstickNotification::HINT_URGENCY, QString("2"));
+    hints.insert(LipstickNotification::HINT_PRIORITY, 100);
+    hints.insert(LipstickNotification::HINT_TRANSIENT, true);
+    hints.insert(LipstickNotification::HINT_USER_REMOVABLE, false);
+    hints.insert(LipstickNotification::HINT_PROGRESS, 0.5);
+    hints.insert(LipstickNotification::HINT_CATEGORY, QString("x-test.category"));
+    hints.insert(LipstickNotification::HINT_OWNER, QString("x-test-owner"));
+    n1.setHints(hints);
+    QCOMPARE(n1.urgency(), 2);
+    QCOMPARE(n1.priority(), 100);
+    QVERIFY(n1.isTransient());
+    QVERIFY(!n1.isUserRemovableByHint());
+    QVERIFY(n1.hasProgress());
+    QCOMPARE(n1.progress(), 0.5);
+    QCOMPARE(n1.category(), QString("x-test.category"));
+    QCOMPARE(n1.owner(), QString("x-test-owner"));
+
+    hints.clear();
+    n1.setHints(hints);
+    QCOMPARE(n1.urgency(), static_cast<int>(LipstickNotification::Normal));
+    QVERIFY(!n1.isTransient());
+    QVERIFY(n1.isUserRemovableByHint());
+    QVERIFY(!n1.hasProgress());
+    QVERIFY(n1.category().isEmpty());
+    QVERIFY(n1.owner().isEmpty());
+}
+
 void Ut_Notification::testSerialization()
 {
     QString appName = "appName1";
@@ -206,12 +247,13 @@ void Ut_Notification::testSerialization()
     QString summary = "summary1";
     QString body = "body1";
     QStringList actions = QStringList() << "action1a" << "action1b";
-    QDateTime timestamp = QDateTime::currentDateTime();
+    QDateTime timestamp(QDate(2013, 1, 1), QTime(12, 34, 56, 789), Qt::UTC);
     QVariantHash hints;
     hints.insert(LipstickNotification::HINT_TIMESTAMP, timestamp);
     int expireTimeout = 1;
 
     LipstickNotification n1(appName, appName, appName, id, appIcon, summary, body, actions, hints, expireTimeout);
+    QCOMPARE(n1.hints().value(LipstickNotification::HINT_TIMESTAMP).toLongLong(), timestamp.toMSecsSinceEpoch());
     LipstickNotification n2;
 
     // Transfer a Notification from n1 to n2 by serializing it to a QDBusArgument and unserializing it
@@ -226,10 +268,51 @@ void Ut_Notification::testSerialization()
     QCOMPARE(n2.body(), n1.body());
     QCOMPARE(n2.actions(), n1.actions());
     QCOMPARE(n2.expireTimeout(), n1.expireTimeout());
-    QCOMPARE(n2.timestamp(), n1.timestamp());
+
+    // Timestamps are serialized as ISO 8601 strings with second precision
+    const QDateTime serializedTimestamp(timestamp.addMSecs(-789));
+    QCOMPARE(n2.timestamp(), serializedTimestamp);
+    QCOMPARE(n2.hints().value(LipstickNotification::HINT_TIMESTAMP).toLongLong(), serializedTimestamp.toMSecsSinceEpoch());
 
     // Disambiguated app name is internal only
     QVERIFY(n2.disambiguatedAppName() != n1.appName());
 }
 
+void Ut_Notification::benchmarkHintValuesMemory()
+{
+    const int count = 500;
+    QVariantHash hints;
+    for (int i = 0; i < 20; ++i) {
+        hints.insert(QString("x-test-hint-%1").arg(i), QString("value %1").arg(i));
+    }
+
+    const int initialUsage = mallinfo().uordblks;
+    QList<LipstickNotification *> notifications;
+    for (int i = 0; i < count; ++i) {
+        LipstickNotification *notification = new LipstickNotification(QString(), QString(), QString(), i, QString(),
+                                                                      QString(), QString(), QStringList(), hints, 0);
+        notification->setHints(hints);
+        notifications.append(notification);
+    }
+    const int unusedUsage = mallinfo().uordblks;
+
+    // The hint values are only generated when they are requested
+    foreach (LipstickNotification *notification, notifications) {
+        QCOMPARE(notification->hintValues().count(), hints.count());
+    }
+    const int usedUsage = mallinfo().uordblks;
+
+    qDebug() << "Bytes per notification without hint values:" << (unusedUsage - initialUsage) / count
+             << "with hint values:" << (usedUsage - initialUsage) / count;
+    QVERIFY(usedUsage > unusedUsage);
+
+    // Changing the hints releases the generated values
+    foreach (LipstickNotification *notification, notifications) {
+        notification->setHints(hints);
+    }
+    QVERIFY(mallinfo().uordblks < usedUsage);
+
+    qDeleteAll(notifications);
+}
+
 QTEST_MAIN(Ut_Notification)
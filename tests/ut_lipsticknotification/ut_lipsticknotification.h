@@ -25,7 +25,9 @@ private slots:
     void testIcon_data();
     void testIcon();
     void testSignals();
+    void testHotHints();
     void testSerialization();
+    void benchmarkHintValuesMemory();
 };
 
 #endif
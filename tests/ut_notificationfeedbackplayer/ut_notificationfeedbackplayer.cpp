@@ -72,14 +72,42 @@ void NotificationManager::identifiedGetNotificationsByCategory()
 {
 }
 
+void NotificationManager::identifiedGetNotificationsSince()
+{
+}
+
 void NotificationManager::identifiedCloseNotification()
 {
 }
 
+void NotificationManager::identifiedUpdateHints()
+{
+}
+
+void NotificationManager::identifiedNotifyMany()
+{
+}
+
+void NotificationManager::identifiedCloseNotifications()
+{
+}
+
 void NotificationManager::identifiedNotify()
 {
 }
 
+void NotificationManager::handleNameOwnerChanged(const QString &, const QString &, const QString &)
+{
+}
+
+void NotificationManager::imageStored(const QString &)
+{
+}
+
+void NotificationManager::writeProgressUpdates()
+{
+}
+
 void ClientIdentifier::getPidReply(QDBusPendingCallWatcher *getPidWatcher)
 {
     Q_UNUSED(getPidWatcher);
@@ -0,0 +1,177 @@
+/***************************************************************************
+**
+** Copyright (c) 2021 Jolla Ltd.
+**
+** This file is part of lipstick.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#include <QtTest/QtTest>
+#include "ut_notificationgroupmodel.h"
+#include "notificationgroupmodel.h"
+#include "notificationmanager_stub.h"
+#include "lipsticknotification.h"
+
+void QTimer::singleShot(int, const QObject *receiver, const char *member)
+{
+    // The "member" string is of form "1member()", so remove the trailing 1 and the ()
+    int memberLength = strlen(member) - 3;
+    char modifiedMember[memberLength + 1];
+    strncpy(modifiedMember, member + 1, memberLength);
+    modifiedMember[memberLength] = 0;
+    QMetaObject::invokeMethod(const_cast<QObject *>(receiver), modifiedMember, Qt::DirectConnection);
+}
+
+namespace {
+
+LipstickNotification *createNotification(uint id, const QString &appName, int day, const QString &owner = QString())
+{
+    QVariantHash hints;
+    hints.insert(LipstickNotification::HINT_TIMESTAMP, QDateTime(QDate(2013, 1, day), QTime(12, 34, 56)));
+    if (!owner.isEmpty()) {
+        hints.insert(LipstickNotification::HINT_OWNER, owner);
+    }
+    return new LipstickNotification(appName, appName, appName, id, "appIcon", "summary", "body",
+                                    QStringList(), hints, 1);
+}
+
+NotificationGroup *group(NotificationGroupModel &model, int index)
+{
+    return qobject_cast<NotificationGroup *>(model.get(index));
+}
+
+}
+
+void Ut_NotificationGroupModel::cleanup()
+{
+    gNotificationManagerStub->stubReset();
+}
+
+void Ut_NotificationGroupModel::testSignalConnections()
+{
+    NotificationGroupModel model;
+    QCOMPARE(disconnect(NotificationManager::instance(), SIGNAL(notificationsModified(const QList<uint> &)), &model, SLOT(updateNotifications(const QList<uint> &))), true);
+    QCOMPARE(disconnect(NotificationManager::instance(), SIGNAL(notificationsRemoved(const QList<uint> &)), &model, SLOT(removeNotifications(const QList<uint> &))), true);
+}
+
+void Ut_NotificationGroupModel::testModelPopulatesOnConstruction()
+{
+    LipstickNotification notification("appName", "appName", "appName", 1, "appIcon", "summary", "body", QStringList(), QVariantHash(), 1);
+    gNotificationManagerStub->stubSetReturnValue("notificationIds", QList<uint>() << 1);
+    gNotificationManagerStub->stubSetReturnValue("notification", &notification);
+    NotificationGroupModel model;
+    QCOMPARE(model.populated(), true);
+    QCOMPARE(model.itemCount(), 1);
+    QCOMPARE(group(model, 0)->key(), QString("appName"));
+    QCOMPARE(group(model, 0)->count(), 1);
+    QCOMPARE(group(model, 0)->topNotification(), &notification);
+}
+
+void Ut_NotificationGroupModel::testNotificationsAreGroupedByOwnerOrApplication()
+{
+    NotificationGroupModel model;
+    QList<LipstickNotification *> notifications;
+    notifications << createNotification(1, "app1", 1)
+                  << createNotification(2, "app2", 2)
+                  << createNotification(3, "app1", 3)
+                  << createNotification(4, "app2", 4, "owner")
+                  << createNotification(5, "app3", 5, "owner");
+    gNotificationManagerStub->stubSetReturnValueList("notification", notifications);
+    model.updateNotifications(QList<uint>() << 1 << 2 << 3 << 4 << 5);
+
+    QCOMPARE(model.itemCount(), 3);
+    QCOMPARE(group(model, 0)->key(), QString("owner"));
+    QCOMPARE(group(model, 0)->appName(), QString("app3"));
+    QCOMPARE(group(model, 0)->count(), 2);
+    QCOMPARE(group(model, 0)->notifications()->get(0), notifications.at(4));
+    QCOMPARE(group(model, 0)->notifications()->get(1), notifications.at(3));
+    QCOMPARE(group(model, 1)->key(), QString("app1"));
+    QCOMPARE(group(model, 1)->notifications()->get(0), notifications.at(2));
+    QCOMPARE(group(model, 1)->notifications()->get(1), notifications.at(0));
+    QCOMPARE(group(model, 2)->key(), QString("app2"));
+    QCOMPARE(group(model, 2)->count(), 1);
+
+    qDeleteAll(notifications);
+}
+
+void Ut_NotificationGroupModel::testGroupsFollowUpdates()
+{
+    NotificationGroupModel model;
+    QList<LipstickNotification *> notifications;
+    notifications << createNotification(1, "app1", 1)
+                  << createNotification(2, "app2", 2)
+                  << createNotification(3, "app1", 3);
+    gNotificationManagerStub->stubSetReturnValueList("notification", notifications);
+    model.updateNotifications(QList<uint>() << 1 << 2 << 3);
+    QCOMPARE(group(model, 0)->key(), QString("app1"));
+    QCOMPARE(group(model, 1)->key(), QString("app2"));
+    NotificationGroup *app1Group = group(model, 0);
+    NotificationGroup *app2Group = group(model, 1);
+
+    // A newer notification moves its group to the top
+    QVariantHash hints;
+    hints.insert(LipstickNotification::HINT_TIMESTAMP, QDateTime(QDate(2013, 1, 4), QTime(12, 34, 56)));
+    notifications.at(1)->setHints(hints);
+    QSignalSpy topNotificationSpy(app2Group, SIGNAL(topNotificationChanged()));
+    gNotificationManagerStub->stubSetReturnValueList("notification", QList<LipstickNotification *>() << notifications.at(1));
+    model.updateNotifications(QList<uint>() << 2);
+    QCOMPARE(model.itemCount(), 2);
+    QCOMPARE(group(model, 0), app2Group);
+    QCOMPARE(group(model, 1), app1Group);
+    QCOMPARE(topNotificationSpy.count(), 1);
+
+    // Moving the top notification of a group to another group reorders both
+    hints.insert(LipstickNotification::HINT_OWNER, "app2");
+    notifications.at(2)->setHints(hints);
+    gNotificationManagerStub->stubSetReturnValueList("notification", QList<LipstickNotification *>() << notifications.at(2));
+    model.updateNotifications(QList<uint>() << 3);
+    QCOMPARE(model.itemCount(), 2);
+    QCOMPARE(group(model, 0), app2Group);
+    QCOMPARE(app2Group->count(), 2);
+    QCOMPARE(app2Group->notifications()->get(0), notifications.at(2));
+    QCOMPARE(app1Group->count(), 1);
+    QCOMPARE(app1Group->topNotification(), notifications.at(0));
+
+    // Notifications which should not be shown are dropped from their groups
+    notifications.at(1)->setSummary(QString());
+    notifications.at(1)->setBody(QString());
+    gNotificationManagerStub->stubSetReturnValueList("notification", QList<LipstickNotification *>() << notifications.at(1));
+    model.updateNotifications(QList<uint>() << 2);
+    QCOMPARE(app2Group->count(), 1);
+    QCOMPARE(app2Group->topNotification(), notifications.at(2));
+
+    qDeleteAll(notifications);
+}
+
+void Ut_NotificationGroupModel::testGroupIsRemovedWithItsLastNotification()
+{
+    NotificationGroupModel model;
+    QList<LipstickNotification *> notifications;
+    notifications << createNotification(1, "app1", 1)
+                  << createNotification(2, "app2", 2)
+                  << createNotification(3, "app2", 3);
+    gNotificationManagerStub->stubSetReturnValueList("notification", notifications);
+    model.updateNotifications(QList<uint>() << 1 << 2 << 3);
+    QCOMPARE(model.itemCount(), 2);
+
+    model.removeNotifications(QList<uint>() << 1);
+    QCOMPARE(model.itemCount(), 1);
+    QCOMPARE(group(model, 0)->key(), QString("app2"));
+
+    model.removeNotifications(QList<uint>() << 3);
+    QCOMPARE(model.itemCount(), 1);
+    QCOMPARE(group(model, 0)->topNotification(), notifications.at(1));
+
+    model.removeNotifications(QList<uint>() << 2 << 1);
+    QCOMPARE(model.itemCount(), 0);
+
+    qDeleteAll(notifications);
+}
+
+QTEST_MAIN(Ut_NotificationGroupModel)
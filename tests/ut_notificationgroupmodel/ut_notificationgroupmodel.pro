@@ -0,0 +1,23 @@
+include(../common.pri)
+TARGET = ut_notificationgroupmodel
+INCLUDEPATH += $$NOTIFICATIONSRCDIR
+INCLUDEPATH += $$UTILITYSRCDIR
+INCLUDEPATH += $$3RDPARTYSRCDIR
+QT += sql dbus qml
+
+# unit test and unit
+SOURCES += \
+    ut_notificationgroupmodel.cpp \
+    $$NOTIFICATIONSRCDIR/notificationgroupmodel.cpp \
+    $$NOTIFICATIONSRCDIR/lipsticknotification.cpp \
+    $$UTILITYSRCDIR/qobjectlistmodel.cpp \
+    $$STUBSDIR/stubbase.cpp \
+
+# unit test and unit
+HEADERS += \
+    ut_notificationgroupmodel.h \
+    $$NOTIFICATIONSRCDIR/notificationgroupmodel.h \
+    $$NOTIFICATIONSRCDIR/lipsticknotification.h \
+    $$NOTIFICATIONSRCDIR/notificationmanager.h \
+    $$UTILITYSRCDIR/qobjectlistmodel.h \
+    $$3RDPARTYSRCDIR/synchronizelists.h
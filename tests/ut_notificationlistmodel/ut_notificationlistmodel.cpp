@@ -41,7 +41,6 @@ void Ut_NotificationListModel::testSignalConnections()
 {
     NotificationListModel model;
     QCOMPARE(disconnect(NotificationManager::instance(), SIGNAL(notificationsModified(const QList<uint> &)), &model, SLOT(updateNotifications(const QList<uint> &))), true);
-    QCOMPARE(disconnect(NotificationManager::instance(), SIGNAL(notificationRemoved(uint)), &model, SLOT(removeNotification(uint))), true);
     QCOMPARE(disconnect(NotificationManager::instance(), SIGNAL(notificationsRemoved(const QList<uint> &)), &model, SLOT(removeNotifications(const QList<uint> &))), true);
     QCOMPARE(disconnect(&model, SIGNAL(clearRequested()), NotificationManager::instance(), SLOT(removeUserRemovableNotifications())), true);
 }
@@ -105,7 +104,7 @@ void Ut_NotificationListModel::testNotificationRemoval()
     LipstickNotification notification("appName", "appName", "appName", 1, "appIcon", "summary", "body", QStringList() << "action", QVariantHash(), 1);
     gNotificationManagerStub->stubSetReturnValue("notification", &notification);
     NotificationListModel model;
-    model.removeNotification(1);
+    model.removeNotifications(QList<uint>() << 1);
     QCOMPARE(model.itemCount(), 0);
     QCOMPARE(model.populated(), true);
 }
@@ -150,6 +149,79 @@ void Ut_NotificationListModel::testNotificationOrdering()
     QCOMPARE(model.get(2), &notification2);
 }
 
+void Ut_NotificationListModel::testEqualNotificationOrdering()
+{
+    NotificationListModel model;
+    QVariantHash hints1;
+    QVariantHash hints2;
+    hints1.insert(LipstickNotification::HINT_TIMESTAMP, QDateTime(QDate(2013, 1, 1), QTime(12, 34, 56)));
+    hints2.insert(LipstickNotification::HINT_TIMESTAMP, QDateTime(QDate(2013, 1, 3), QTime(12, 34, 56)));
+    LipstickNotification notification1("appName1", "appName1", "appName1", 1, "appIcon1", "summary1", "body1", QStringList(), hints1, 1);
+    LipstickNotification notification2("appName2", "appName2", "appName2", 2, "appIcon2", "summary2", "body2", QStringList(), hints2, 1);
+    LipstickNotification equalNotification(notification1);
+    gNotificationManagerStub->stubSetReturnValue("notification", &notification2);
+    model.updateNotification(2);
+    gNotificationManagerStub->stubSetReturnValue("notification", &notification1);
+    model.updateNotification(1);
+
+    // A notification sorting equal to a listed one is placed after it, as in the batch updates
+    gNotificationManagerStub->stubSetReturnValue("notification", &equalNotification);
+    model.updateNotification(1);
+    QCOMPARE(model.itemCount(), 3);
+    QCOMPARE(model.get(0), &notification2);
+    QCOMPARE(model.get(1), &notification1);
+    QCOMPARE(model.get(2), &equalNotification);
+
+    // An updated notification is placed after the other notifications sorting equal to it
+    gNotificationManagerStub->stubSetReturnValue("notification", &notification1);
+    model.updateNotification(1);
+    QCOMPARE(model.itemCount(), 3);
+    QCOMPARE(model.get(0), &notification2);
+    QCOMPARE(model.get(1), &equalNotification);
+    QCOMPARE(model.get(2), &notification1);
+}
+
+void Ut_NotificationListModel::testBatchedNotificationUpdate()
+{
+    NotificationListModel model;
+    QList<LipstickNotification *> notifications;
+    for (int i = 1; i <= 5; ++i) {
+        QVariantHash hints;
+        hints.insert(LipstickNotification::HINT_TIMESTAMP, QDateTime(QDate(2013, 1, i), QTime(12, 34, 56)));
+        notifications.append(new LipstickNotification("appName", "appName", "appName", i, "appIcon", "summary", "body",
+                                                      QStringList(), hints, 1));
+        gNotificationManagerStub->stubSetReturnValue("notification", notifications.last());
+        model.updateNotification(i);
+    }
+    QCOMPARE(model.itemCount(), 5);
+    QCOMPARE(model.get(0), notifications.at(4));
+    QCOMPARE(model.get(4), notifications.at(0));
+
+    // Move the two oldest notifications to the top and hide the newest one
+    QVariantHash hints;
+    hints.insert(LipstickNotification::HINT_TIMESTAMP, QDateTime(QDate(2013, 1, 7), QTime(12, 34, 56)));
+    notifications.at(0)->setHints(hints);
+    hints.insert(LipstickNotification::HINT_TIMESTAMP, QDateTime(QDate(2013, 1, 6), QTime(12, 34, 56)));
+    notifications.at(1)->setHints(hints);
+    notifications.at(4)->setSummary(QString());
+    notifications.at(4)->setBody(QString());
+    gNotificationManagerStub->stubSetReturnValueList("notification",
+            QList<LipstickNotification *>() << notifications.at(0) << notifications.at(1) << notifications.at(4));
+
+    QSignalSpy insertedSpy(&model, SIGNAL(rowsInserted(QModelIndex,int,int)));
+    QSignalSpy removedSpy(&model, SIGNAL(rowsRemoved(QModelIndex,int,int)));
+    model.updateNotifications(QList<uint>() << 1 << 2 << 5);
+    QCOMPARE(model.itemCount(), 4);
+    QCOMPARE(model.get(0), notifications.at(0));
+    QCOMPARE(model.get(1), notifications.at(1));
+    QCOMPARE(model.get(2), notifications.at(3));
+    QCOMPARE(model.get(3), notifications.at(2));
+    QCOMPARE(insertedSpy.count(), 1);
+    QCOMPARE(removedSpy.count(), 2);
+
+    qDeleteAll(notifications);
+}
+
 void Ut_NotificationListModel::testNotificationUpdate()
 {
     LipstickNotification notification("appName", "appName", "appName", 1, "appIcon", "summary", "body", QStringList() << "action", QVariantHash(), 1);
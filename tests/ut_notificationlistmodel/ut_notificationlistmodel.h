@@ -31,6 +31,8 @@ private slots:
     void testAlreadyAddedNotificationIsRemovedIfNoLongerAddable();
     void testNotificationRemoval();
     void testNotificationOrdering();
+    void testEqualNotificationOrdering();
+    void testBatchedNotificationUpdate();
     void testNotificationUpdate();
     void testRemoteActions();
 };
@@ -17,6 +17,7 @@
 #include "aboutsettings_stub.h"
 
 #include "notificationmanager.h"
+#include "notificationimagestore.h"
 #include "notificationmanageradaptor_stub.h"
 #include "lipsticknotification.h"
 #include "categorydefinitionstore_stub.h"
@@ -26,6 +27,7 @@
 #include <QSqlRecord>
 #include <QSqlError>
 #include <mremoteaction.h>
+#include <unistd.h>
 
 
 void Ut_NotificationManager::init()
@@ -50,7 +52,7 @@ void Ut_NotificationManager::testCapabilities()
 {
     // Check the supported capabilities includes all the Nemo hints
     QStringList capabilities = NotificationManager::instance()->GetCapabilities();
-    QCOMPARE(capabilities.count(), 11);
+    QCOMPARE(capabilities.count(), 15);
     QCOMPARE((bool)capabilities.contains("body"), true);
     QCOMPARE((bool)capabilities.contains("actions"), true);
     QCOMPARE((bool)capabilities.contains("persistence"), true);
@@ -62,6 +64,10 @@ void Ut_NotificationManager::testCapabilities()
     QCOMPARE((bool)capabilities.contains("x-nemo-remote-actions"), true);
     QCOMPARE((bool)capabilities.contains(LipstickNotification::HINT_USER_REMOVABLE), true);
     QCOMPARE((bool)capabilities.contains("x-nemo-get-notifications"), true);
+    QCOMPARE((bool)capabilities.contains("x-nemo-notify-many"), true);
+    QCOMPARE((bool)capabilities.contains("x-nemo-close-notifications"), true);
+    QCOMPARE((bool)capabilities.contains("x-nemo-get-notifications-since"), true);
+    QCOMPARE((bool)capabilities.contains("x-nemo-update-hints"), true);
 }
 
 void Ut_NotificationManager::testRemovingInexistingNotification()
@@ -342,6 +348,164 @@ void Ut_NotificationManager::testRemoveUserRemovableNotifications()
     QCOMPARE(closedIds.contains(id6), true);
 }
 
+void Ut_NotificationManager::testClosingNotificationsIsBatched()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    QList<uint> ids;
+    for (int i = 0; i < 1200; ++i) {
+        ids.append(manager->Notify("app1", 0, QString(), "summary", "body", QStringList(), QVariantHash(), 0));
+    }
+    manager->m_databaseWriter->flush();
+
+    QSignalSpy closedSpy(manager, SIGNAL(NotificationClosed(uint, uint)));
+    QSignalSpy batchClosedSpy(manager, SIGNAL(NotificationsClosed(QList<uint>, uint)));
+    QSignalSpy batchRemovedSpy(manager, SIGNAL(notificationsRemoved(QList<uint>)));
+    manager->closeNotifications(ids, NotificationManager::NotificationDismissedByUser);
+    QCOMPARE(closedSpy.count(), ids.count());
+    QCOMPARE(batchClosedSpy.count(), 1);
+    QCOMPARE(batchClosedSpy.last().at(0).value<QList<uint> >().count(), ids.count());
+    QCOMPARE(batchClosedSpy.last().at(1).toUInt(), static_cast<uint>(NotificationManager::NotificationDismissedByUser));
+    QCOMPARE(batchRemovedSpy.count(), 1);
+    QVERIFY(manager->notificationIds().isEmpty());
+
+    manager->m_databaseWriter->flush();
+    QSqlQuery query(*manager->m_database);
+    foreach (const QString &table, QStringList() << "notifications" << "actions" << "hints" << "internal_hints") {
+        QVERIFY(query.exec(QString("SELECT COUNT(*) FROM %1 WHERE id BETWEEN %2 AND %3")
+                           .arg(table).arg(ids.first()).arg(ids.last())));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 0);
+    }
+}
+
+void Ut_NotificationManager::testNotificationsOverRateLimitAreCollapsed()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    const int burst = manager->m_rateLimitBurst;
+    const int rate = manager->m_rateLimitRate;
+    manager->m_rateLimitBurst = 2;
+    manager->m_rateLimitRate = 0;
+    const quint64 throttledCount = manager->m_throttledNotificationCount;
+
+    const int clientPid = getppid();
+    uint id1 = manager->handleNotify(clientPid, "app1", 0, QString(), "summary1", "body", QStringList(), QVariantHash(), 0);
+    uint id2 = manager->handleNotify(clientPid, "app1", 0, QString(), "summary2", "body", QStringList(), QVariantHash(), 0);
+    QVERIFY(id1 != id2);
+
+    QCOMPARE(manager->handleNotify(clientPid, "app1", 0, QString(), "summary3", "body", QStringList(), QVariantHash(), 0), id2);
+    QCOMPARE(manager->notification(id2)->summary(), QString("summary3"));
+    QCOMPARE(manager->notification(id2)->itemCount(), 2);
+    QCOMPARE(manager->handleNotify(clientPid, "app1", 0, QString(), "summary4", "body", QStringList(), QVariantHash(), 0), id2);
+    QCOMPARE(manager->notification(id2)->itemCount(), 3);
+    QCOMPARE(manager->notificationIds().count(), 2);
+
+    // Notifications from lipstick itself are not limited
+    QVERIFY(manager->Notify("app1", 0, QString(), "summary5", "body", QStringList(), QVariantHash(), 0) != id2);
+
+    const QVariantMap statistics(manager->GetStatistics());
+    QCOMPARE(statistics.value("throttledNotifications").toULongLong(), throttledCount + 2);
+    QCOMPARE(statistics.value("throttledApplications").toMap().count(), 1);
+
+    // Rejected notifications neither use up the burst nor count as throttled
+    const int unprivilegedPid = 0x7ffffffe; // no such process
+    QVariantHash persistentHints;
+    persistentHints.insert(LipstickNotification::HINT_USER_REMOVABLE, false);
+    for (int i = 0; i < 3; ++i) {
+        QCOMPARE(manager->handleNotify(unprivilegedPid, "app2", 0, QString(), "summary", "body", QStringList(),
+                                       persistentHints, 0), 0u);
+    }
+    uint id3 = manager->handleNotify(unprivilegedPid, "app2", 0, QString(), "summary6", "body", QStringList(), QVariantHash(), 0);
+    uint id4 = manager->handleNotify(unprivilegedPid, "app2", 0, QString(), "summary7", "body", QStringList(), QVariantHash(), 0);
+    QVERIFY(id3 != 0);
+    QVERIFY(id4 != 0);
+    QVERIFY(id3 != id4);
+    QCOMPARE(manager->GetStatistics().value("throttledNotifications").toULongLong(), throttledCount + 2);
+
+    manager->m_rateLimitBurst = burst;
+    manager->m_rateLimitRate = rate;
+    manager->m_rateLimits.clear();
+    manager->closeNotifications(manager->notificationIds());
+}
+
+void Ut_NotificationManager::testNotifyManyAndCloseNotifications()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    uint existingId = manager->Notify("app1", 0, QString(), "summary", "body", QStringList(), QVariantHash(), 0);
+
+    NotificationRequestList requests;
+    for (int i = 0; i < 3; ++i) {
+        NotificationRequest request;
+        request.appName = "app2";
+        request.summary = QString("summary%1").arg(i);
+        requests.append(request);
+    }
+    requests[1].replacesId = existingId;
+
+    QSignalSpy modifiedSpy(manager, SIGNAL(notificationsModified(QList<uint>)));
+    const QList<uint> ids(manager->NotifyMany(requests));
+    QCOMPARE(ids.count(), 3);
+    QCOMPARE(ids.at(1), existingId);
+    QVERIFY(ids.at(0) != 0 && ids.at(2) != 0 && ids.at(0) != ids.at(2));
+    QCOMPARE(manager->notification(existingId)->summary(), QString("summary1"));
+    QCOMPARE(manager->notification(ids.at(2))->summary(), QString("summary2"));
+
+    QTRY_COMPARE(modifiedSpy.count(), 1);
+    QVERIFY(modifiedSpy.last().at(0).value<QList<uint> >().toSet().contains(ids.toSet()));
+
+    QSignalSpy batchClosedSpy(manager, SIGNAL(NotificationsClosed(QList<uint>, uint)));
+    manager->CloseNotifications(ids);
+    QCOMPARE(batchClosedSpy.count(), 1);
+    QCOMPARE(batchClosedSpy.last().at(1).toUInt(), static_cast<uint>(NotificationManager::CloseNotificationCalled));
+    QVERIFY(manager->notificationIds().isEmpty());
+}
+
+void Ut_NotificationManager::testGetNotificationsSince()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    uint id1 = manager->Notify("app1", 0, QString(), "summary1", "body", QStringList(), QVariantHash(), 0);
+    uint id2 = manager->Notify("app1", 0, QString(), "summary2", "body", QStringList(), QVariantHash(), 0);
+
+    QList<uint> removedIds;
+    quint64 token = 0;
+    bool resyncRequired = false;
+    NotificationList notifications = manager->GetNotificationsSince(0, removedIds, token, resyncRequired);
+    QVERIFY(resyncRequired);
+    QCOMPARE(notifications.notifications().count(), manager->notificationIds().count());
+
+    // Only the changes since the returned token are reported
+    uint id3 = manager->Notify("app1", 0, QString(), "summary3", "body", QStringList(), QVariantHash(), 0);
+    manager->Notify("app1", id1, QString(), "summary1b", "body", QStringList(), QVariantHash(), 0);
+    manager->closeNotifications(QList<uint>() << id2);
+    const quint64 previousToken = token;
+    notifications = manager->GetNotificationsSince(previousToken, removedIds, token, resyncRequired);
+    QVERIFY(!resyncRequired);
+    QVERIFY(token > previousToken);
+    QCOMPARE(notifications.notifications().count(), 2);
+    QCOMPARE(notifications.notifications().at(0)->id(), id3);
+    QCOMPARE(notifications.notifications().at(1)->id(), id1);
+    QCOMPARE(removedIds, QList<uint>() << id2);
+
+    notifications = manager->GetNotificationsSince(token, removedIds, token, resyncRequired);
+    QVERIFY(!resyncRequired);
+    QVERIFY(notifications.notifications().isEmpty());
+    QVERIFY(removedIds.isEmpty());
+
+    // A token of another instance requires a resync even if its sequence is known to this instance
+    const quint64 otherToken = (static_cast<quint64>(manager->m_changeEpoch + 1) << 32) | static_cast<quint32>(token);
+    notifications = manager->GetNotificationsSince(otherToken, removedIds, token, resyncRequired);
+    QVERIFY(resyncRequired);
+    QCOMPARE(notifications.notifications().count(), manager->notificationIds().count());
+    QCOMPARE(static_cast<quint32>(token >> 32), manager->m_changeEpoch);
+
+    // Unprivileged clients are denied access
+    const int unprivilegedPid = 0x7ffffffe; // no such process
+    QVERIFY(!manager->handleGetNotificationsSince(unprivilegedPid, token, &notifications, &removedIds, &token,
+                                                  &resyncRequired));
+    QVERIFY(notifications.notifications().isEmpty());
+
+    manager->closeNotifications(manager->notificationIds());
+}
+
 void Ut_NotificationManager::testRemoveRequested()
 {
     NotificationManager *manager = NotificationManager::instance();
@@ -360,6 +524,45 @@ void Ut_NotificationManager::testRemoveRequested()
     QCOMPARE(closedSpy.last().at(1).toUInt(), static_cast<uint>(NotificationManager::NotificationDismissedByUser));
 }
 
+void Ut_NotificationManager::testCategoryIndexFollowsReplacement()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    QVariantHash hints;
+    hints.insert(LipstickNotification::HINT_CATEGORY, "category1");
+    uint id = manager->Notify("app1", 0, QString(), QString(), QString(), QStringList(), hints, 0);
+    QCOMPARE(manager->m_categoryIndex.values("category1"), QList<uint>() << id);
+
+    hints.insert(LipstickNotification::HINT_CATEGORY, "category2");
+    manager->Notify("app1", id, QString(), QString(), QString(), QStringList(), hints, 0);
+    QVERIFY(manager->m_categoryIndex.values("category1").isEmpty());
+    QCOMPARE(manager->m_categoryIndex.values("category2"), QList<uint>() << id);
+
+    // Removing by the previous category leaves the notification in place
+    manager->removeNotificationsWithCategory("category1");
+    QVERIFY(manager->notification(id));
+
+    manager->removeNotificationsWithCategory("category2");
+    QVERIFY(!manager->notification(id));
+    QVERIFY(manager->m_categoryIndex.isEmpty());
+    QVERIFY(manager->m_indexKeys.isEmpty());
+}
+
+void Ut_NotificationManager::testIdentifiedClientIsForgottenOnDisconnect()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    manager->m_clientPids.insert(":1.42", 1234);
+    manager->m_clientPids.insert(":1.43", 1235);
+
+    // Well-known names changing owner do not affect the identified clients
+    manager->handleNameOwnerChanged("org.example.Service", ":1.42", QString());
+    manager->handleNameOwnerChanged(":1.42", QString(), ":1.42");
+    QCOMPARE(manager->m_clientPids.count(), 2);
+
+    manager->handleNameOwnerChanged(":1.42", ":1.42", QString());
+    QCOMPARE(manager->m_clientPids.count(), 1);
+    QCOMPARE(manager->m_clientPids.value(":1.43"), 1235);
+}
+
 void Ut_NotificationManager::testImmediateExpiration()
 {
     QVariantHash hints;
@@ -379,4 +582,438 @@ void Ut_NotificationManager::testImmediateExpiration()
     QCOMPARE(closedSpy.last().at(1).toUInt(), static_cast<uint>(NotificationManager::NotificationExpired));
 }
 
+void Ut_NotificationManager::testDisplayedNotificationExpires()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    uint id1 = manager->Notify("app1", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 1);
+    uint id2 = manager->Notify("app1", 0, QString(), QString(), QString(), QStringList(), QVariantHash(), 60000);
+    manager->markNotificationDisplayed(id1);
+    manager->markNotificationDisplayed(id2);
+    QCOMPARE(manager->m_expirationQueue.count(), 2);
+    QCOMPARE(manager->m_expirationQueue.first(), id1);
+    QVERIFY(manager->m_expirationTimer.isActive());
+
+    QSignalSpy closedSpy(manager, SIGNAL(NotificationClosed(uint, uint)));
+    QTRY_COMPARE(closedSpy.count(), 1);
+    QCOMPARE(closedSpy.last().at(0).toUInt(), id1);
+    QCOMPARE(closedSpy.last().at(1).toUInt(), static_cast<uint>(NotificationManager::NotificationExpired));
+    QCOMPARE(manager->m_expirationQueue.count(), 1);
+    QVERIFY(manager->m_expirationTimer.isActive());
+
+    // Closing a notification removes it from the expiration queue
+    manager->CloseNotification(id2);
+    QVERIFY(manager->m_expirationQueue.isEmpty());
+    QVERIFY(manager->m_expirationTimes.isEmpty());
+}
+
+void Ut_NotificationManager::testDatabaseWriterFlush()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    uint id = manager->Notify("app1", 0, QString(), "summary", "body", QStringList(), QVariantHash(), 0);
+    QVERIFY(manager->m_databaseWriter != 0);
+
+    // Once flushed, the modifications are visible through the main thread connection
+    manager->m_databaseWriter->flush();
+    QSqlQuery query(*manager->m_database);
+    QVERIFY(query.exec(QString("SELECT summary FROM notifications WHERE id=%1").arg(id)));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toString(), QString("summary"));
+
+    // Single removals are reported as a batch too, so that the models only follow the batches
+    QSignalSpy batchRemovedSpy(manager, SIGNAL(notificationsRemoved(QList<uint>)));
+    manager->CloseNotification(id);
+    QCOMPARE(batchRemovedSpy.count(), 1);
+    QCOMPARE(batchRemovedSpy.last().at(0).value<QList<uint> >(), QList<uint>() << id);
+    manager->m_databaseWriter->flush();
+    QVERIFY(query.exec(QString("SELECT COUNT(*) FROM notifications WHERE id=%1").arg(id)));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toInt(), 0);
+}
+
+void Ut_NotificationManager::testHintsArePersisted()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    QVariantHash hints;
+    for (int i = 0; i < 20; ++i) {
+        hints.insert(QString("x-test-hint-%1").arg(i), i);
+    }
+    uint id = manager->Notify("app1", 0, QString(), "summary", "body",
+                              QStringList() << "action1" << "Action 1" << "action2" << "Action 2", hints, 0);
+    manager->m_databaseWriter->flush();
+
+    QSqlQuery query(*manager->m_database);
+    QVERIFY(query.exec(QString("SELECT COUNT(*) FROM hints WHERE id=%1 AND hint LIKE 'x-test-hint-%'").arg(id)));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toInt(), 20);
+    QVERIFY(query.exec(QString("SELECT COUNT(*) FROM actions WHERE id=%1").arg(id)));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toInt(), 2);
+
+    manager->closeNotifications(manager->notificationIds());
+}
+
+void Ut_NotificationManager::testTimestampIsStoredAsInteger()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    QVariantHash hints;
+    hints.insert(LipstickNotification::HINT_TIMESTAMP, "2021-03-04T07:06:07+02:00");
+    uint id = manager->Notify("app1", 0, QString(), "summary", "body", QStringList(), hints, 0);
+    manager->m_databaseWriter->flush();
+
+    const qint64 expected(QDateTime(QDate(2021, 3, 4), QTime(5, 6, 7), Qt::UTC).toMSecsSinceEpoch());
+    LipstickNotification *notification = manager->notification(id);
+    QCOMPARE(notification->hints().value(LipstickNotification::HINT_TIMESTAMP).toLongLong(), expected);
+
+    QSqlQuery query(*manager->m_database);
+    QVERIFY(query.exec(QString("SELECT timestamp, typeof(timestamp) FROM notifications WHERE id=%1").arg(id)));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toLongLong(), expected);
+    QCOMPARE(query.value(1).toString(), QString("integer"));
+    QVERIFY(query.exec(QString("SELECT COUNT(*) FROM hints WHERE id=%1 AND hint='%2'")
+                       .arg(id).arg(LipstickNotification::HINT_TIMESTAMP)));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toInt(), 0);
+
+    manager->closeNotifications(manager->notificationIds());
+}
+
+void Ut_NotificationManager::testReplacedNotificationIsUpdatedInDatabase()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    QVariantHash hints;
+    hints.insert("x-test-kept", 1);
+    hints.insert("x-test-changed", 2);
+    hints.insert("x-test-removed", 3);
+    uint id = manager->Notify("app1", 0, QString(), "summary", "body",
+                              QStringList() << "action1" << "Action 1", hints, 0);
+
+    hints.remove("x-test-removed");
+    hints.insert("x-test-changed", 4);
+    hints.insert("x-test-added", 5);
+    QCOMPARE(manager->Notify("app1", id, QString(), "summary2", "body",
+                             QStringList() << "action2" << "Action 2", hints, 0), id);
+    manager->m_databaseWriter->flush();
+
+    QSqlQuery query(*manager->m_database);
+    QVERIFY(query.exec(QString("SELECT summary, body FROM notifications WHERE id=%1").arg(id)));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toString(), QString("summary2"));
+    QCOMPARE(query.value(1).toString(), QString("body"));
+
+    QVERIFY(query.exec(QString("SELECT action FROM actions WHERE id=%1").arg(id)));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toString(), QString("action2"));
+    QVERIFY(!query.next());
+
+    QVariantHash storedHints;
+    QVERIFY(query.exec(QString("SELECT hint, value FROM hints WHERE id=%1 AND hint LIKE 'x-test-%'").arg(id)));
+    while (query.next()) {
+        storedHints.insert(query.value(0).toString(), query.value(1));
+    }
+    QCOMPARE(storedHints.count(), 3);
+    QCOMPARE(storedHints.value("x-test-kept").toInt(), 1);
+    QCOMPARE(storedHints.value("x-test-changed").toInt(), 4);
+    QCOMPARE(storedHints.value("x-test-added").toInt(), 5);
+
+    manager->closeNotifications(manager->notificationIds());
+}
+
+void Ut_NotificationManager::testUpdateHints()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    QVariantHash hints;
+    hints.insert("x-test-kept", 1);
+    hints.insert("x-test-changed", 2);
+    hints.insert("x-test-removed", 3);
+    uint id = manager->Notify("app1", 0, QString(), "summary", "body", QStringList(), hints, 0);
+    const QVariant timestamp(manager->notification(id)->hints().value(LipstickNotification::HINT_TIMESTAMP));
+
+    QSignalSpy modifiedSpy(manager, SIGNAL(notificationModified(uint)));
+    QVariantHash changed;
+    changed.insert("x-test-changed", 4);
+    changed.insert("x-test-added", 5);
+    manager->UpdateHints(id, changed, QStringList() << "x-test-removed" << LipstickNotification::HINT_TIMESTAMP);
+    QCOMPARE(modifiedSpy.count(), 1);
+    QCOMPARE(modifiedSpy.last().at(0).toUInt(), id);
+
+    LipstickNotification *notification = manager->notification(id);
+    QCOMPARE(notification->summary(), QString("summary"));
+    QCOMPARE(notification->hints().value("x-test-kept").toInt(), 1);
+    QCOMPARE(notification->hints().value("x-test-changed").toInt(), 4);
+    QCOMPARE(notification->hints().value("x-test-added").toInt(), 5);
+    QVERIFY(!notification->hints().contains("x-test-removed"));
+    QCOMPARE(notification->hints().value(LipstickNotification::HINT_TIMESTAMP), timestamp);
+
+    manager->m_databaseWriter->flush();
+    QVariantHash storedHints;
+    QSqlQuery query(*manager->m_database);
+    QVERIFY(query.exec(QString("SELECT hint, value FROM hints WHERE id=%1 AND hint LIKE 'x-test-%'").arg(id)));
+    while (query.next()) {
+        storedHints.insert(query.value(0).toString(), query.value(1));
+    }
+    QCOMPARE(storedHints.count(), 3);
+    QCOMPARE(storedHints.value("x-test-kept").toInt(), 1);
+    QCOMPARE(storedHints.value("x-test-changed").toInt(), 4);
+    QCOMPARE(storedHints.value("x-test-added").toInt(), 5);
+
+    // Updates that change nothing are not published
+    manager->UpdateHints(id, changed, QStringList() << "x-test-removed");
+    QCOMPARE(modifiedSpy.count(), 1);
+
+    // Updating an unknown notification is reported to the caller
+    QCOMPARE(manager->handleUpdateHints(getppid(), id + 1000, changed, QStringList()), QDBusError::InvalidArgs);
+    QVERIFY(!manager->notification(id + 1000));
+    QCOMPARE(manager->handleUpdateHints(getppid(), id, changed, QStringList()), QDBusError::NoError);
+
+    manager->closeNotifications(manager->notificationIds());
+}
+
+void Ut_NotificationManager::testStoredImagesAreShared()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    NotificationImageStore *store = manager->m_imageStore;
+    QVERIFY(store);
+
+    const QString key = NotificationImageStore::imageKey(1, 1, 4, true, QByteArray(4, '\xff'));
+    QFile file(store->fileName(key));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.close();
+
+    // Notifications waiting for the image get it once it has been written
+    uint id1 = manager->Notify("app1", 0, QString(), "summary", "body", QStringList(), QVariantHash(), 0);
+    manager->m_pendingImages.insert(id1, key);
+    store->addReference(id1, key);
+    store->setPending(key);
+    manager->imageStored(key);
+    QCOMPARE(manager->notification(id1)->hints().value(LipstickNotification::HINT_IMAGE_PATH).toString(),
+             store->url(key));
+    QVERIFY(manager->m_pendingImages.isEmpty());
+
+    // Notifications referring to the same image share the file
+    QVariantHash hints;
+    hints.insert(LipstickNotification::HINT_IMAGE_PATH, store->url(key));
+    uint id2 = manager->Notify("app1", 0, QString(), "summary", "body", QStringList(), hints, 0);
+    manager->closeNotifications(QList<uint>() << id1);
+    QVERIFY(QFile::exists(store->fileName(key)));
+
+    // The file is removed with the last notification referring to it
+    QCOMPARE(manager->Notify("app1", id2, QString(), "summary", "body", QStringList(), QVariantHash(), 0), id2);
+    QVERIFY(!QFile::exists(store->fileName(key)));
+
+    manager->closeNotifications(manager->notificationIds());
+}
+
+void Ut_NotificationManager::testOutdatedNotificationImageIsIgnored()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    NotificationImageStore *store = manager->m_imageStore;
+    QVERIFY(store);
+
+    const QString key1 = NotificationImageStore::imageKey(1, 1, 4, true, QByteArray(4, '\x01'));
+    const QString key2 = NotificationImageStore::imageKey(1, 1, 4, true, QByteArray(4, '\x02'));
+    const QString key3 = NotificationImageStore::imageKey(1, 1, 4, true, QByteArray(4, '\x03'));
+    foreach (const QString &key, QStringList() << key1 << key2 << key3) {
+        QFile file(store->fileName(key));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.close();
+        store->setPending(key);
+    }
+
+    uint id = manager->Notify("app1", 0, QString(), "summary", "body", QStringList(), QVariantHash(), 60000);
+    manager->markNotificationDisplayed(id);
+    manager->reportModifications();
+
+    // Only the image of the latest replacement is attached
+    manager->m_pendingImages.insert(id, key2);
+    store->addReference(id, key2);
+    QSignalSpy modifiedSpy(manager, SIGNAL(notificationModified(uint)));
+    manager->imageStored(key1);
+    QVERIFY(!manager->notification(id)->hints().contains(LipstickNotification::HINT_IMAGE_PATH));
+    QVERIFY(!QFile::exists(store->fileName(key1)));
+    manager->imageStored(key2);
+    QCOMPARE(manager->notification(id)->hints().value(LipstickNotification::HINT_IMAGE_PATH).toString(),
+             store->url(key2));
+    QVERIFY(!manager->m_pendingImages.contains(id));
+
+    // Attaching the image is only reported in the batched modifications and keeps the expiration
+    QCOMPARE(modifiedSpy.count(), 0);
+    QVERIFY(manager->m_modifiedIds.contains(id));
+    QVERIFY(manager->m_expirationTimes.contains(id));
+
+    // Replacing the notification cancels pending images
+    manager->m_pendingImages.insert(id, key3);
+    QCOMPARE(manager->Notify("app1", id, QString(), "summary", "body", QStringList(), QVariantHash(), 0), id);
+    manager->imageStored(key3);
+    QVERIFY(!manager->notification(id)->hints().contains(LipstickNotification::HINT_IMAGE_PATH));
+    QVERIFY(!QFile::exists(store->fileName(key3)));
+
+    manager->closeNotifications(manager->notificationIds());
+}
+
+void Ut_NotificationManager::testProgressUpdatesAreCoalesced()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    QVariantHash hints;
+    hints.insert(LipstickNotification::HINT_PROGRESS, 0.25);
+    uint id = manager->Notify("app1", 0, QString(), "summary", "body", QStringList(), hints, 0);
+    manager->commit();
+    manager->m_databaseCommitTimer.stop();
+
+    QSignalSpy modifiedSpy(manager, SIGNAL(notificationModified(uint)));
+    hints.insert(LipstickNotification::HINT_PROGRESS, 0.5);
+    manager->Notify("app1", id, QString(), "summary", "body", QStringList(), hints, 0);
+    QCOMPARE(modifiedSpy.count(), 1);
+    QCOMPARE(manager->notification(id)->progress(), 0.5);
+    QVERIFY(manager->m_progressRecords.contains(id));
+    QVERIFY(manager->m_progressTimer.isActive());
+
+    // Nothing is written or committed for the coalesced update
+    QVERIFY(!manager->m_databaseCommitTimer.isActive());
+    QVERIFY(!manager->m_snapshotOutdated);
+
+    const QString progressQuery(QString("SELECT value FROM hints WHERE id=%1 AND hint='%2'")
+                                .arg(id).arg(LipstickNotification::HINT_PROGRESS));
+    manager->m_databaseWriter->flush();
+    QSqlQuery query(*manager->m_database);
+    QVERIFY(query.exec(progressQuery));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toDouble(), 0.25);
+
+    // The latest state is written once the updates settle
+    manager->writeProgressUpdates();
+    QVERIFY(manager->m_progressRecords.isEmpty());
+    manager->m_databaseWriter->flush();
+    QVERIFY(query.exec(progressQuery));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toDouble(), 0.5);
+
+    // Completed progress is written right away
+    hints.insert(LipstickNotification::HINT_PROGRESS, 0.75);
+    manager->Notify("app1", id, QString(), "summary", "body", QStringList(), hints, 0);
+    hints.insert(LipstickNotification::HINT_PROGRESS, 1.0);
+    manager->Notify("app1", id, QString(), "summary", "body", QStringList(), hints, 0);
+    QVERIFY(manager->m_progressRecords.isEmpty());
+    manager->m_databaseWriter->flush();
+    QVERIFY(query.exec(progressQuery));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toDouble(), 1.0);
+
+    manager->closeNotifications(manager->notificationIds());
+}
+
+void Ut_NotificationManager::testDisplayedProgressNotificationKeepsExpiration()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    QVariantHash hints;
+    hints.insert(LipstickNotification::HINT_PROGRESS, 0.25);
+    uint id = manager->Notify("app1", 0, QString(), "summary", "body", QStringList(), hints, 60000);
+    manager->markNotificationDisplayed(id);
+    QVERIFY(manager->m_expirationTimes.contains(id));
+
+    // Replacing the notification resets its expiration right away, also when the progress is coalesced
+    hints.insert(LipstickNotification::HINT_PROGRESS, 0.5);
+    manager->Notify("app1", id, QString(), "summary", "body", QStringList(), hints, 60000);
+    QVERIFY(manager->m_progressRecords.contains(id));
+    QVERIFY(!manager->m_expirationTimes.contains(id));
+
+    // Displaying the replaced notification starts a new expiration which the deferred write keeps
+    manager->markNotificationDisplayed(id);
+    QVERIFY(manager->m_expirationTimes.contains(id));
+    manager->writeProgressUpdates();
+    QVERIFY(manager->m_progressRecords.isEmpty());
+    QVERIFY(manager->m_expirationTimes.contains(id));
+    QCOMPARE(manager->m_expirationQueue.values(), QList<uint>() << id);
+
+    manager->m_databaseWriter->flush();
+    QSqlQuery query(*manager->m_database);
+    QVERIFY(query.exec(QString("SELECT COUNT(*) FROM expiration WHERE id=%1").arg(id)));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toInt(), 1);
+
+    manager->closeNotifications(manager->notificationIds());
+}
+
+void Ut_NotificationManager::testNotificationsAreRestoredFromDatabase()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    QVariantHash hints;
+    hints.insert("x-test-hint", "value");
+    uint id = manager->Notify("app1", 0, "icon", "summary", "body",
+                              QStringList() << "b" << "Action B" << "a" << "Action A", hints, 5);
+    manager->m_databaseWriter->flush();
+
+    QHash<uint, LipstickNotification *> published(manager->m_notifications);
+    manager->m_notifications.clear();
+    manager->fetchData(false);
+
+    LipstickNotification *restored = manager->m_notifications.value(id);
+    QVERIFY(restored);
+    QCOMPARE(restored->appName(), published.value(id)->appName());
+    QCOMPARE(restored->summary(), QString("summary"));
+    QCOMPARE(restored->body(), QString("body"));
+    QCOMPARE(restored->expireTimeout(), 5);
+    QCOMPARE(restored->actions(), QStringList() << "b" << "Action B" << "a" << "Action A");
+    QCOMPARE(restored->hints().value("x-test-hint").toString(), QString("value"));
+    QCOMPARE(restored->timestamp(), published.value(id)->timestamp());
+    QVERIFY(restored->restored());
+
+    qDeleteAll(manager->m_notifications);
+    manager->m_notifications = published;
+    manager->closeNotifications(manager->notificationIds());
+}
+
+void Ut_NotificationManager::testNotificationsAreRestoredFromSnapshot()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    QVariantHash hints;
+    hints.insert("x-test-hint", "value");
+    hints.insert("x-test-number", 42);
+    uint id = manager->Notify("app1", 0, "icon", "summary", "body",
+                              QStringList() << "a" << "Action A", hints, 5);
+    manager->commit();
+    manager->m_databaseWriter->flush();
+    QVERIFY(QFile::exists(manager->snapshotFileName()));
+
+    QHash<uint, LipstickNotification *> published(manager->m_notifications);
+    manager->m_notifications.clear();
+    QVERIFY(manager->loadSnapshot(false));
+
+    LipstickNotification *restored = manager->m_notifications.value(id);
+    QVERIFY(restored);
+    QCOMPARE(restored->summary(), QString("summary"));
+    QCOMPARE(restored->body(), QString("body"));
+    QCOMPARE(restored->expireTimeout(), 5);
+    QCOMPARE(restored->actions(), QStringList() << "a" << "Action A");
+    QCOMPARE(restored->hints().value("x-test-hint").toString(), QString("value"));
+    QCOMPARE(restored->hints().value("x-test-number").toInt(), 42);
+    QCOMPARE(restored->timestamp(), published.value(id)->timestamp());
+    qDeleteAll(manager->m_notifications);
+    manager->m_notifications.clear();
+
+    // A snapshot not matching the database generation is not used
+    manager->m_generation++;
+    QVERIFY(!manager->loadSnapshot(false));
+    QVERIFY(manager->m_notifications.isEmpty());
+    manager->m_generation--;
+
+    manager->m_notifications = published;
+    manager->closeNotifications(manager->notificationIds());
+}
+
+void Ut_NotificationManager::benchmarkNotifyWithHints()
+{
+    NotificationManager *manager = NotificationManager::instance();
+    QVariantHash hints;
+    for (int i = 0; i < 20; ++i) {
+        hints.insert(QString("x-test-hint-%1").arg(i), QString("value %1").arg(i));
+    }
+
+    QBENCHMARK {
+        manager->Notify("app1", 0, QString(), "summary", "body", QStringList(), hints, 0);
+        manager->m_databaseWriter->flush();
+    }
+
+    manager->closeNotifications(manager->notificationIds());
+}
+
 QTEST_MAIN(Ut_NotificationManager)
@@ -35,8 +35,27 @@ private slots:
     void testInvokingActionClosesNotificationIfUserRemovable();
     void testListingNotifications();
     void testRemoveUserRemovableNotifications();
+    void testClosingNotificationsIsBatched();
+    void testNotificationsOverRateLimitAreCollapsed();
+    void testNotifyManyAndCloseNotifications();
+    void testGetNotificationsSince();
     void testRemoveRequested();
+    void testCategoryIndexFollowsReplacement();
+    void testIdentifiedClientIsForgottenOnDisconnect();
     void testImmediateExpiration();
+    void testDisplayedNotificationExpires();
+    void testDatabaseWriterFlush();
+    void testHintsArePersisted();
+    void testTimestampIsStoredAsInteger();
+    void testReplacedNotificationIsUpdatedInDatabase();
+    void testUpdateHints();
+    void testStoredImagesAreShared();
+    void testOutdatedNotificationImageIsIgnored();
+    void testProgressUpdatesAreCoalesced();
+    void testDisplayedProgressNotificationKeepsExpiration();
+    void testNotificationsAreRestoredFromDatabase();
+    void testNotificationsAreRestoredFromSnapshot();
+    void benchmarkNotifyWithHints();
 
 signals:
     void actionInvoked(QString action, QString actionText = QString());
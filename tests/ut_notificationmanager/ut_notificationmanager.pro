@@ -9,6 +9,8 @@ PKGCONFIG += mlite5
 SOURCES += \
     ut_notificationmanager.cpp \
     $$NOTIFICATIONSRCDIR/notificationmanager.cpp \
+    $$NOTIFICATIONSRCDIR/notificationdatabasewriter.cpp \
+    $$NOTIFICATIONSRCDIR/notificationimagestore.cpp \
     $$NOTIFICATIONSRCDIR/lipsticknotification.cpp \
     $$STUBSDIR/stubbase.cpp \
 
@@ -16,6 +18,8 @@ SOURCES += \
 HEADERS += \
     ut_notificationmanager.h \
     $$NOTIFICATIONSRCDIR/notificationmanager.h \
+    $$NOTIFICATIONSRCDIR/notificationdatabasewriter.h \
+    $$NOTIFICATIONSRCDIR/notificationimagestore.h \
     $$NOTIFICATIONSRCDIR/lipsticknotification.h \
     $$NOTIFICATIONSRCDIR/notificationmanageradaptor.h \
     $$NOTIFICATIONSRCDIR/categorydefinitionstore.h \
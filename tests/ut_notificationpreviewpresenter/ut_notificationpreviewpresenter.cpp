@@ -176,14 +176,42 @@ void NotificationManager::identifiedGetNotificationsByCategory()
 {
 }
 
+void NotificationManager::identifiedGetNotificationsSince()
+{
+}
+
 void NotificationManager::identifiedCloseNotification()
 {
 }
 
+void NotificationManager::identifiedUpdateHints()
+{
+}
+
+void NotificationManager::identifiedNotifyMany()
+{
+}
+
+void NotificationManager::identifiedCloseNotifications()
+{
+}
+
 void NotificationManager::identifiedNotify()
 {
 }
 
+void NotificationManager::handleNameOwnerChanged(const QString &, const QString &, const QString &)
+{
+}
+
+void NotificationManager::imageStored(const QString &)
+{
+}
+
+void NotificationManager::writeProgressUpdates()
+{
+}
+
 void ClientIdentifier::getPidReply(QDBusPendingCallWatcher *getPidWatcher)
 {
     Q_UNUSED(getPidWatcher);
@@ -205,12 +233,15 @@ static uint lastFeedbackId()
 
 enum Urgency { Low = 0, Normal = 1, Critical = 2 };
 
-LipstickNotification *createNotification(uint id, Urgency urgency = Normal)
+LipstickNotification *createNotification(uint id, Urgency urgency = Normal, int priority = 0)
 {
     QVariantHash hints;
     hints.insert(LipstickNotification::HINT_PREVIEW_SUMMARY, "summary");
     hints.insert(LipstickNotification::HINT_PREVIEW_BODY, "body");
     hints.insert(LipstickNotification::HINT_URGENCY, static_cast<int>(urgency));
+    if (priority != 0) {
+        hints.insert(LipstickNotification::HINT_PRIORITY, priority);
+    }
     LipstickNotification *notification = new LipstickNotification("ut_notificationpreviewpresenter",
                                                                   "", "", id, "", "", "", QStringList(), hints, -1);
     notificationManagerNotification.insert(id, notification);
@@ -586,6 +617,80 @@ void Ut_NotificationPreviewPresenter::testCriticalNotificationIsMarkedAfterShowi
     QCOMPARE(notificationManagerCloseNotificationIds.count(), 0);
 }
 
+void Ut_NotificationPreviewPresenter::testQueueOrderedByUrgencyAndPriority()
+{
+    NotificationPreviewPresenter presenter(screenLock, deviceLock);
+    createNotification(1);
+    LipstickNotification *notification2 = createNotification(2);
+    createNotification(3, Normal, 10);
+    createNotification(4, Critical);
+    createNotification(5);
+    QTest::qWait(0);
+
+    // The first notification is shown right away, the others are queued
+    presenter.updateNotification(1);
+    presenter.updateNotification(2);
+    presenter.updateNotification(3);
+    presenter.updateNotification(4);
+    presenter.updateNotification(5);
+    QCOMPARE(presenter.m_notificationQueue.count(), 4);
+
+    // Repeated updates of a queued notification keep a single entry in the queue
+    presenter.updateNotification(5);
+    presenter.updateNotification(5);
+    QCOMPARE(presenter.m_notificationQueue.count(), 4);
+
+    // A removed notification is dropped from the queue
+    presenter.removeNotification(5);
+    QCOMPARE(presenter.m_notificationQueue.count(), 3);
+    QCOMPARE(presenter.m_queuedNotifications.contains(5), false);
+
+    // An update raising the urgency moves the notification ahead of notifications queued later
+    QVariantHash hints(notification2->hints());
+    hints.insert(LipstickNotification::HINT_URGENCY, static_cast<int>(Critical));
+    notification2->setHints(hints);
+    presenter.updateNotification(2);
+    QCOMPARE(presenter.m_notificationQueue.count(), 3);
+
+    // Critical notifications are shown first in the order they were queued, then the ones with higher priority
+    gNotificationFeedbackPlayerStub->stubReset();
+    presenter.showNextNotification();
+    QCOMPARE(presenter.notification()->id(), (uint)2);
+    presenter.showNextNotification();
+    QCOMPARE(presenter.notification()->id(), (uint)4);
+    presenter.showNextNotification();
+    QCOMPARE(presenter.notification()->id(), (uint)3);
+    presenter.showNextNotification();
+    QCOMPARE(presenter.notification(), (LipstickNotification *)0);
+    QCOMPARE(presenter.m_queuedNotifications.isEmpty(), true);
+    QCOMPARE(playedFeedbacks(), 3);
+}
+
+void Ut_NotificationPreviewPresenter::testRemovingBackgroundNotificationShowsNextNotification()
+{
+    NotificationPreviewPresenter presenter(screenLock, deviceLock);
+    gNotificationFeedbackPlayerStub->stubSetReturnValue("addNotification", true);
+    LipstickNotification *notification1 = createNotification(1, Low);
+    LipstickNotification *notification2 = createNotification(2);
+    QTest::qWait(0);
+
+    // A notification without a preview plays its feedback in the background for a while
+    presenter.updateNotification(1);
+    QCOMPARE(presenter.notification(), notification1);
+    QCOMPARE(presenter.m_currentInBackground, true);
+    QCOMPARE(presenter.m_backgroundNotificationTimer.isActive(), true);
+
+    presenter.updateNotification(2);
+    QCOMPARE(presenter.notification(), notification1);
+
+    // Removing the notification ends its timeslot and the next notification is shown right away
+    presenter.removeNotification(1);
+    QCOMPARE(presenter.m_backgroundNotificationTimer.isActive(), false);
+    QCOMPARE(presenter.notification(), notification2);
+    QCOMPARE(presenter.m_currentInBackground, false);
+    QCOMPARE(lastFeedbackId(), (uint)2);
+}
+
 QWaylandSurface *surface = (QWaylandSurface *)1;
 void Ut_NotificationPreviewPresenter::testNotificationPreviewsDisabled_data()
 {
@@ -43,6 +43,8 @@ private slots:
     void testNotificationNotShownIfTouchScreenIsLockedAndDisplayIsOff_data();
     void testNotificationNotShownIfTouchScreenIsLockedAndDisplayIsOff();
     void testCriticalNotificationIsMarkedAfterShowing();
+    void testQueueOrderedByUrgencyAndPriority();
+    void testRemovingBackgroundNotificationShowsNextNotification();
     void testNotificationPreviewsDisabled_data();
     void testNotificationPreviewsDisabled();
 